@@ -0,0 +1,52 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <random>
+#include <vector>
+
+#include "ExprTree.h"
+
+
+// Builds a random tree with `leafCount` leaves and makes it the root of
+// `tree`. Leaves are alternately literals and the symbol `x`. Operations are
+// created by repeatedly combining randomly chosen subtrees, so the order in
+// which nodes sit in memory bears no relation to the order in which a depth
+// first walk reaches them. Once the tree outgrows the last level cache, most
+// nodes reached are cache misses.
+inline void
+buildScatteredTree(exprtree::ExprTree& tree, size_t leafCount, unsigned seed = 745) {
+  std::mt19937_64 random{seed};
+  std::vector<const exprtree::Expression*> subtrees;
+  subtrees.reserve(leafCount);
+  for (size_t i = 0; i < leafCount; ++i) {
+    if (i % 2 == 0) {
+      subtrees.push_back(&tree.addLiteral(static_cast<int64_t>(i % 7) + 1));
+    } else {
+      subtrees.push_back(&tree.addSymbol("x"));
+    }
+  }
+
+  constexpr exprtree::OpCode ops[] = {
+    exprtree::OpCode::ADD,
+    exprtree::OpCode::SUBTRACT,
+    exprtree::OpCode::MULTIPLY,
+  };
+  while (subtrees.size() > 1) {
+    std::shuffle(subtrees.begin(), subtrees.end(), random);
+    std::vector<const exprtree::Expression*> combined;
+    combined.reserve(subtrees.size() / 2 + 1);
+    for (size_t i = 0; i + 1 < subtrees.size(); i += 2) {
+      auto op = ops[random() % std::size(ops)];
+      combined.push_back(&tree.addOperation(op, *subtrees[i], *subtrees[i + 1]));
+    }
+    if (subtrees.size() % 2 == 1) {
+      combined.push_back(subtrees.back());
+    }
+    subtrees.swap(combined);
+  }
+
+  if (!subtrees.empty()) {
+    tree.setRoot(*subtrees.front());
+  }
+}
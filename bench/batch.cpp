@@ -0,0 +1,77 @@
+#include <benchmark/benchmark.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Batch.h"
+#include "Columns.h"
+#include "ExprOps.h"
+#include "Trees.h"
+
+using exprtree::BatchProgram;
+using exprtree::Environment;
+using exprtree::ExprTree;
+using exprtree::MappedColumns;
+
+
+constexpr size_t ROW_COUNT = 1 << 16;
+
+
+static const std::vector<std::byte>&
+savedColumns() {
+  static const auto bytes = [] {
+    std::mt19937_64 random{745};
+    std::vector<int64_t> x(ROW_COUNT);
+    for (auto& value : x) {
+      value = static_cast<int64_t>(random() % 100);
+    }
+    std::vector<std::string> names{"x"};
+    std::vector<std::vector<int64_t>> columns{std::move(x)};
+    return exprtree::serializeColumns(names, columns);
+  }();
+  return bytes;
+}
+
+
+// Evaluates the tree once per row, loading each row into an Environment as a
+// batch job without columns would.
+static void
+BM_EvaluateRows(benchmark::State& state) {
+  ExprTree tree;
+  buildScatteredTree(tree, static_cast<size_t>(state.range(0)));
+  auto columns = MappedColumns::view(savedColumns());
+  auto x = columns.values(0);
+  Environment env;
+
+  for (auto _ : state) {
+    for (auto value : x) {
+      env.set("x", value);
+      benchmark::DoNotOptimize(evaluate(tree, env));
+    }
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * ROW_COUNT));
+}
+
+
+static void
+BM_EvaluateBatch(benchmark::State& state) {
+  ExprTree tree;
+  buildScatteredTree(tree, static_cast<size_t>(state.range(0)));
+  auto columns = MappedColumns::view(savedColumns());
+  auto overflow = static_cast<exprtree::OverflowMode>(state.range(1));
+  auto program = BatchProgram::compile(tree, columns, overflow);
+  std::vector<int64_t> values(ROW_COUNT);
+  std::vector<uint8_t> valid(ROW_COUNT);
+
+  for (auto _ : state) {
+    program->run(0, values, valid);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * ROW_COUNT));
+}
+
+
+BENCHMARK(BM_EvaluateRows)->Arg(8)->Arg(64)->Arg(512);
+BENCHMARK(BM_EvaluateBatch)->ArgsProduct({{8, 64, 512},
+                                          {exprtree::WRAP, exprtree::CHECKED, exprtree::SATURATING}});
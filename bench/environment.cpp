@@ -0,0 +1,275 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ExprTree.h"
+#include "LayeredEnvironment.h"
+#include "VersionedEnvironment.h"
+
+using exprtree::Environment;
+using exprtree::LayeredEnvironment;
+using exprtree::VersionedEnvironment;
+
+
+static std::vector<std::string>
+makeNames(size_t count) {
+  std::vector<std::string> names;
+  names.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    names.push_back("variable_" + std::to_string(i));
+  }
+  return names;
+}
+
+
+// Looks names up in a random order, so that each lookup is independent of
+// the last.
+static std::vector<size_t>
+makeOrder(size_t count) {
+  std::vector<size_t> order(count);
+  for (size_t i = 0; i < count; ++i) {
+    order[i] = i;
+  }
+  std::shuffle(order.begin(), order.end(), std::mt19937_64{17});
+  return order;
+}
+
+
+// The node based map that environments were built on before, for comparison.
+static void
+BM_GetUnorderedMap(benchmark::State& state) {
+  auto names = makeNames(static_cast<size_t>(state.range(0)));
+  auto order = makeOrder(names.size());
+  std::unordered_map<std::string, uint64_t> map;
+  for (size_t i = 0; i < names.size(); ++i) {
+    map[names[i]] = i;
+  }
+
+  for (auto _ : state) {
+    for (auto i : order) {
+      benchmark::DoNotOptimize(map.find(names[i]));
+    }
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * order.size()));
+}
+
+
+static void
+BM_GetByName(benchmark::State& state) {
+  auto names = makeNames(static_cast<size_t>(state.range(0)));
+  auto order = makeOrder(names.size());
+  Environment environment;
+  for (size_t i = 0; i < names.size(); ++i) {
+    environment.set(names[i], static_cast<int64_t>(i));
+  }
+
+  for (auto _ : state) {
+    for (auto i : order) {
+      benchmark::DoNotOptimize(environment.get(names[i]));
+    }
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * order.size()));
+}
+
+
+static void
+BM_GetByHash(benchmark::State& state) {
+  auto names = makeNames(static_cast<size_t>(state.range(0)));
+  auto order = makeOrder(names.size());
+  Environment environment;
+  std::vector<uint64_t> hashes;
+  for (size_t i = 0; i < names.size(); ++i) {
+    environment.set(names[i], static_cast<int64_t>(i));
+    hashes.push_back(exprtree::hashName(names[i]));
+  }
+
+  for (auto _ : state) {
+    for (auto i : order) {
+      benchmark::DoNotOptimize(environment.get(names[i], hashes[i]));
+    }
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * order.size()));
+}
+
+
+static void
+BM_BuildOneAtATime(benchmark::State& state) {
+  auto names = makeNames(static_cast<size_t>(state.range(0)));
+
+  for (auto _ : state) {
+    Environment environment;
+    for (size_t i = 0; i < names.size(); ++i) {
+      environment.set(names[i], static_cast<int64_t>(i));
+    }
+    benchmark::DoNotOptimize(environment);
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * names.size()));
+}
+
+
+static void
+BM_BuildSetAll(benchmark::State& state) {
+  auto names = makeNames(static_cast<size_t>(state.range(0)));
+  std::vector<int64_t> values(names.size());
+  for (size_t i = 0; i < names.size(); ++i) {
+    values[i] = static_cast<int64_t>(i);
+  }
+
+  for (auto _ : state) {
+    Environment environment;
+    environment.setAll(names, values);
+    benchmark::DoNotOptimize(environment);
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * names.size()));
+}
+
+
+// Includes the cost of preparing the bindings, as a caller building them from
+// scratch would pay it.
+static void
+BM_BuildPrepared(benchmark::State& state) {
+  auto names = makeNames(static_cast<size_t>(state.range(0)));
+
+  for (auto _ : state) {
+    std::vector<std::pair<std::string, int64_t>> prepared;
+    prepared.reserve(names.size());
+    for (size_t i = 0; i < names.size(); ++i) {
+      prepared.emplace_back(names[i], static_cast<int64_t>(i));
+    }
+    Environment environment{std::move(prepared)};
+    benchmark::DoNotOptimize(environment);
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * names.size()));
+}
+
+
+static Environment
+makeEnvironment(const std::vector<std::string>& names) {
+  Environment environment;
+  for (size_t i = 0; i < names.size(); ++i) {
+    environment.set(names[i], static_cast<int64_t>(i));
+  }
+  return environment;
+}
+
+
+// Each variant changes four bindings of the base and reads one back.
+static void
+BM_VariantByCopy(benchmark::State& state) {
+  auto names = makeNames(static_cast<size_t>(state.range(0)));
+  auto base = makeEnvironment(names);
+
+  for (auto _ : state) {
+    auto variant = base;
+    for (size_t i = 0; i < 4; ++i) {
+      variant.set(names[i], -1);
+    }
+    benchmark::DoNotOptimize(variant.get(names.back()));
+  }
+}
+
+
+static void
+BM_VariantByLayer(benchmark::State& state) {
+  auto names = makeNames(static_cast<size_t>(state.range(0)));
+  auto base = std::make_shared<const LayeredEnvironment>(makeEnvironment(names));
+
+  for (auto _ : state) {
+    LayeredEnvironment variant{base};
+    for (size_t i = 0; i < 4; ++i) {
+      variant.set(names[i], -1);
+    }
+    benchmark::DoNotOptimize(variant.get(names.back()));
+  }
+}
+
+
+// Looks every name up in a layer `state.range(1)` layers below the bindings.
+static void
+BM_GetLayered(benchmark::State& state) {
+  auto names = makeNames(static_cast<size_t>(state.range(0)));
+  auto order = makeOrder(names.size());
+  auto layer = std::make_shared<const LayeredEnvironment>(makeEnvironment(names));
+  for (int64_t depth = 1; depth < state.range(1); ++depth) {
+    layer = std::make_shared<const LayeredEnvironment>(layer);
+  }
+  LayeredEnvironment leaf{layer};
+
+  for (auto _ : state) {
+    for (auto i : order) {
+      benchmark::DoNotOptimize(leaf.get(names[i]));
+    }
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * order.size()));
+}
+
+
+// The same chain as BM_GetLayered, flattened once before it is read.
+static void
+BM_GetFlattened(benchmark::State& state) {
+  auto names = makeNames(static_cast<size_t>(state.range(0)));
+  auto order = makeOrder(names.size());
+  auto layer = std::make_shared<const LayeredEnvironment>(makeEnvironment(names));
+  for (int64_t depth = 1; depth < state.range(1); ++depth) {
+    layer = std::make_shared<const LayeredEnvironment>(layer);
+  }
+  auto flat = LayeredEnvironment{layer}.flatten();
+
+  for (auto _ : state) {
+    for (auto i : order) {
+      benchmark::DoNotOptimize(flat.get(names[i]));
+    }
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * order.size()));
+}
+
+
+// Readers share one environment with a writer. Each iteration takes a
+// consistent view of the bindings and reads eight of them from it.
+static void
+BM_ReadUnderMutex(benchmark::State& state) {
+  static std::mutex mutex;
+  static Environment environment = makeEnvironment(makeNames(4096));
+  static auto names = makeNames(8);
+
+  for (auto _ : state) {
+    std::lock_guard lock{mutex};
+    for (const auto& name : names) {
+      benchmark::DoNotOptimize(environment.get(name));
+    }
+  }
+}
+
+
+static void
+BM_ReadSnapshot(benchmark::State& state) {
+  static VersionedEnvironment environment{makeEnvironment(makeNames(4096))};
+  static auto names = makeNames(8);
+
+  for (auto _ : state) {
+    auto snapshot = environment.snapshot();
+    for (const auto& name : names) {
+      benchmark::DoNotOptimize(snapshot->get(name));
+    }
+  }
+}
+
+
+BENCHMARK(BM_GetUnorderedMap)->Arg(16)->Arg(4096)->Arg(1 << 20);
+BENCHMARK(BM_GetByName)->Arg(16)->Arg(4096)->Arg(1 << 20);
+BENCHMARK(BM_GetByHash)->Arg(16)->Arg(4096)->Arg(1 << 20);
+BENCHMARK(BM_BuildOneAtATime)->Arg(16)->Arg(4096)->Arg(1 << 16);
+BENCHMARK(BM_BuildSetAll)->Arg(16)->Arg(4096)->Arg(1 << 16);
+BENCHMARK(BM_BuildPrepared)->Arg(16)->Arg(4096)->Arg(1 << 16);
+BENCHMARK(BM_VariantByCopy)->Arg(16)->Arg(4096)->Arg(1 << 16);
+BENCHMARK(BM_VariantByLayer)->Arg(16)->Arg(4096)->Arg(1 << 16);
+BENCHMARK(BM_GetLayered)->ArgsProduct({{4096}, {1, 2, 16}});
+BENCHMARK(BM_GetFlattened)->ArgsProduct({{4096}, {16}});
+BENCHMARK(BM_ReadUnderMutex)->ThreadRange(1, 4);
+BENCHMARK(BM_ReadSnapshot)->ThreadRange(1, 4);
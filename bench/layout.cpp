@@ -0,0 +1,92 @@
+#include <benchmark/benchmark.h>
+
+#include <map>
+#include <memory>
+
+#include "ExprOps.h"
+#include "ExprTree.h"
+#include "Relayout.h"
+#include "Traversal.h"
+#include "Trees.h"
+
+using exprtree::Environment;
+using exprtree::ExprTree;
+using exprtree::Layout;
+
+
+// Each benchmark argument selects how the tree sits in memory. Anything other
+// than a `Layout` keeps the nodes in the order they were allocated.
+constexpr int64_t ALLOCATION_ORDER = -1;
+
+
+static const ExprTree&
+treeWithLayout(size_t leafCount, int64_t layout) {
+  static std::map<std::pair<size_t, int64_t>, std::unique_ptr<ExprTree>> trees;
+  auto& tree = trees[{leafCount, layout}];
+  if (!tree) {
+    tree = std::make_unique<ExprTree>();
+    buildScatteredTree(*tree, leafCount);
+    if (layout != ALLOCATION_ORDER) {
+      relayout(*tree, static_cast<Layout>(layout));
+    }
+  }
+  return *tree;
+}
+
+
+static void
+BM_EvaluateLayout(benchmark::State& state) {
+  const auto& tree = treeWithLayout(static_cast<size_t>(state.range(0)), state.range(1));
+  Environment environment;
+  environment.set("x", 3);
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(evaluate(tree, environment));
+  }
+  state.SetItemsProcessed(state.iterations() * (2 * state.range(0) - 1));
+}
+
+
+static void
+BM_CountOpsLayout(benchmark::State& state) {
+  const auto& tree = treeWithLayout(static_cast<size_t>(state.range(0)), state.range(1));
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(countOps(tree));
+  }
+  state.SetItemsProcessed(state.iterations() * (2 * state.range(0) - 1));
+}
+
+
+static void
+BM_TraverseLayout(benchmark::State& state) {
+  const auto& tree = treeWithLayout(static_cast<size_t>(state.range(0)), state.range(1));
+
+  for (auto _ : state) {
+    size_t count = 0;
+    traversal::traverse<traversal::EpochVisits>(tree,
+      [&count] (auto*) { ++count; },
+      [] (auto*, auto*) { });
+    benchmark::DoNotOptimize(count);
+  }
+  state.SetItemsProcessed(state.iterations() * (2 * state.range(0) - 1));
+}
+
+
+static void
+layoutArguments(benchmark::internal::Benchmark* benchmark) {
+  for (int64_t leaves : {int64_t{1} << 14, int64_t{1} << 22}) {
+    for (int64_t layout : {ALLOCATION_ORDER,
+                           int64_t{Layout::PREORDER},
+                           int64_t{Layout::VAN_EMDE_BOAS}}) {
+      benchmark->Args({leaves, layout});
+    }
+  }
+  benchmark->ArgNames({"leaves", "layout"});
+  benchmark->Unit(benchmark::kMillisecond);
+}
+
+
+BENCHMARK(BM_EvaluateLayout)->Apply(layoutArguments);
+BENCHMARK(BM_CountOpsLayout)->Apply(layoutArguments);
+BENCHMARK(BM_TraverseLayout)->Apply(layoutArguments);
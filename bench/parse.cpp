@@ -0,0 +1,115 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <map>
+#include <random>
+#include <string>
+
+#include "ExprTree.h"
+#include "ParallelParse.h"
+#include "Parser.h"
+#include "WorkStealingPool.h"
+
+using exprtree::ExprTree;
+using exprtree::Parser;
+using exprtree::parseLines;
+
+
+// Builds a corpus of about `size` bytes of newline separated infix formulas
+// that mixes literals of varied length, short and long names, negative
+// numbers, and parenthesized groups. The corpus is generated in memory so that
+// its size can be scaled up to measure sustained throughput.
+static const std::string&
+corpusOfSize(size_t size) {
+  static std::map<size_t, std::string> corpora;
+  auto& corpus = corpora[size];
+  if (!corpus.empty()) {
+    return corpus;
+  }
+
+  static constexpr const char* NAMES[] = {
+    "x", "y", "rate", "principal", "monthly_payment_amount", "t0", "accumulated_interest_total"
+  };
+  static constexpr char OPERATORS[] = {'+', '-', '*', '/'};
+
+  std::mt19937_64 random{42};
+  auto operand = [&] {
+    if (random() % 2 == 0) {
+      corpus += NAMES[random() % std::size(NAMES)];
+    } else {
+      corpus += std::to_string(static_cast<int64_t>(random() >> (random() % 64)) - 1000);
+    }
+  };
+
+  corpus.reserve(size + 256);
+  while (corpus.size() < size) {
+    operand();
+    for (auto terms = random() % 16; terms > 0; --terms) {
+      corpus += ' ';
+      corpus += OPERATORS[random() % std::size(OPERATORS)];
+      corpus += ' ';
+      if (random() % 4 == 0) {
+        corpus += '(';
+        operand();
+        corpus += " * ";
+        operand();
+        corpus += ')';
+      } else {
+        operand();
+      }
+    }
+    corpus += '\n';
+  }
+  return corpus;
+}
+
+
+static void
+BM_ParseCorpus(benchmark::State& state) {
+  const auto& corpus = corpusOfSize(static_cast<size_t>(state.range(0)));
+  Parser parser;
+  size_t formulas = 0;
+
+  for (auto _ : state) {
+    ExprTree tree;
+    std::string_view rest = corpus;
+    formulas = 0;
+    while (!rest.empty()) {
+      auto end = rest.find('\n');
+      benchmark::DoNotOptimize(parser.parse(rest.substr(0, end), tree));
+      rest.remove_prefix(end + 1);
+      ++formulas;
+    }
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * corpus.size()));
+  state.counters["formulas"] = static_cast<double>(formulas);
+}
+
+// The corpus size in bytes. Measuring sustained throughput on larger inputs
+// needs another size added here.
+BENCHMARK(BM_ParseCorpus)
+  ->Arg(1 << 20)
+  ->Arg(64 << 20)
+  ->Unit(benchmark::kMillisecond);
+
+
+static void
+BM_ParseCorpusParallel(benchmark::State& state) {
+  const auto& corpus = corpusOfSize(static_cast<size_t>(state.range(0)));
+  traversal::WorkStealingPool pool{static_cast<size_t>(state.range(1))};
+
+  for (auto _ : state) {
+    size_t formulas = 0;
+    parseLines(corpus, pool, [&formulas] (exprtree::ParsedChunk& chunk) {
+      formulas += chunk.roots.size();
+    });
+    benchmark::DoNotOptimize(formulas);
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * corpus.size()));
+}
+
+// The corpus size in bytes and the number of workers.
+BENCHMARK(BM_ParseCorpusParallel)
+  ->ArgsProduct({{64 << 20}, {1, 2, 4, 8}})
+  ->Unit(benchmark::kMillisecond)
+  ->UseRealTime();
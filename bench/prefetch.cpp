@@ -0,0 +1,82 @@
+
+#include <benchmark/benchmark.h>
+
+#include <map>
+#include <memory>
+
+#include "ExprOps.h"
+#include "ExprTree.h"
+#include "Traversal.h"
+#include "Trees.h"
+
+using exprtree::Environment;
+using exprtree::EvaluationOptions;
+using exprtree::ExprTree;
+
+
+// Trees are expensive to build, so each size is built once and shared by all
+// of the benchmarks that use it.
+static const ExprTree&
+treeWithLeaves(size_t leafCount) {
+  static std::map<size_t, std::unique_ptr<ExprTree>> trees;
+  auto& tree = trees[leafCount];
+  if (!tree) {
+    tree = std::make_unique<ExprTree>();
+    buildScatteredTree(*tree, leafCount);
+  }
+  return *tree;
+}
+
+
+static void
+BM_Evaluate(benchmark::State& state) {
+  const auto& tree = treeWithLeaves(static_cast<size_t>(state.range(0)));
+  EvaluationOptions options{static_cast<size_t>(state.range(1))};
+  Environment environment;
+  environment.set("x", 3);
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(evaluate(tree, environment, options));
+  }
+  state.SetItemsProcessed(state.iterations() * (2 * state.range(0) - 1));
+}
+
+
+// With hashed visits, the cost of the visited set tends to hide the cost of
+// reaching the nodes themselves, so both are measured.
+template <class Visits>
+static void
+BM_Walk(benchmark::State& state) {
+  const auto& tree = treeWithLeaves(static_cast<size_t>(state.range(0)));
+  auto distance = static_cast<size_t>(state.range(1));
+
+  for (auto _ : state) {
+    auto treeWalk = traversal::walk<Visits>(tree);
+    treeWalk.setPrefetchDistance(distance);
+    size_t count = 0;
+    for (const auto& step : treeWalk) {
+      count += step.discovered ? 1 : 0;
+    }
+    benchmark::DoNotOptimize(count);
+  }
+  state.SetItemsProcessed(state.iterations() * (2 * state.range(0) - 1));
+}
+
+
+// The smaller tree fits in cache, where prefetching should make little
+// difference. The larger one is several hundred megabytes.
+static void
+prefetchArguments(benchmark::internal::Benchmark* benchmark) {
+  for (int64_t leaves : {int64_t{1} << 14, int64_t{1} << 22}) {
+    for (int64_t distance : {0, 1, 2, 4, 8, 16}) {
+      benchmark->Args({leaves, distance});
+    }
+  }
+  benchmark->ArgNames({"leaves", "distance"});
+  benchmark->Unit(benchmark::kMillisecond);
+}
+
+
+BENCHMARK(BM_Evaluate)->Apply(prefetchArguments);
+BENCHMARK_TEMPLATE(BM_Walk, traversal::HashedVisits)->Apply(prefetchArguments);
+BENCHMARK_TEMPLATE(BM_Walk, traversal::EpochVisits)->Apply(prefetchArguments);
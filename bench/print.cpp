@@ -0,0 +1,80 @@
+#include <benchmark/benchmark.h>
+
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include "ExprTree.h"
+#include "Printer.h"
+#include "Relayout.h"
+#include "Trees.h"
+
+using exprtree::ExprTree;
+using exprtree::Expression;
+using exprtree::Operation;
+
+
+static const ExprTree&
+packedTreeWithLeaves(size_t leafCount) {
+  static std::map<size_t, std::unique_ptr<ExprTree>> trees;
+  auto& tree = trees[leafCount];
+  if (!tree) {
+    tree = std::make_unique<ExprTree>();
+    buildScatteredTree(*tree, leafCount);
+    relayout(*tree);
+  }
+  return *tree;
+}
+
+
+// A straightforward printer for comparison, which recurses, writes through an
+// ostream, and parenthesizes every operation.
+static void
+printToStream(const Expression& expression, std::ostream& out) {
+  visit(expression, exprtree::overloaded{
+    [&out] (const exprtree::Literal& literal) { out << literal.value; },
+    [&out] (const exprtree::Symbol& symbol) { out << symbol.name; },
+    [&out] (const Operation& operation) {
+      static constexpr char OPERATORS[] = {'+', '-', '*', '/'};
+      out << '(';
+      printToStream(operation.lhs, out);
+      out << ' ' << OPERATORS[operation.opCode] << ' ';
+      printToStream(operation.rhs, out);
+      out << ')';
+    },
+  });
+}
+
+
+static void
+BM_PrintStream(benchmark::State& state) {
+  const auto& tree = packedTreeWithLeaves(static_cast<size_t>(state.range(0)));
+  size_t bytes = 0;
+
+  for (auto _ : state) {
+    std::ostringstream out;
+    printToStream(*tree.getRoot(), out);
+    bytes += out.str().size();
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(bytes));
+}
+
+
+static void
+BM_PrintBuffer(benchmark::State& state) {
+  const auto& tree = packedTreeWithLeaves(static_cast<size_t>(state.range(0)));
+  std::string out;
+  size_t bytes = 0;
+
+  for (auto _ : state) {
+    out.clear();
+    print(tree, out);
+    bytes += out.size();
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(bytes));
+}
+
+
+BENCHMARK(BM_PrintStream)->Arg(1 << 10)->Arg(1 << 20);
+BENCHMARK(BM_PrintBuffer)->Arg(1 << 10)->Arg(1 << 20);
@@ -0,0 +1,172 @@
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <map>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "ExprOps.h"
+#include "ExprTree.h"
+#include "Relayout.h"
+#include "Trees.h"
+
+using exprtree::Environment;
+using exprtree::ExprTree;
+using exprtree::Expression;
+using exprtree::Literal;
+using exprtree::Operation;
+using exprtree::Symbol;
+
+
+// The trees are relaid out in preorder so that the cost of dispatch is not
+// hidden behind cache misses.
+static const ExprTree&
+packedTreeWithLeaves(size_t leafCount) {
+  static std::map<size_t, std::unique_ptr<ExprTree>> trees;
+  auto& tree = trees[leafCount];
+  if (!tree) {
+    tree = std::make_unique<ExprTree>();
+    buildScatteredTree(*tree, leafCount);
+    relayout(*tree);
+  }
+  return *tree;
+}
+
+
+// The same passes as the library provides, but dispatched through the
+// inheritance based visitors, with their virtual calls on every node. They
+// look symbols up by hash and combine values with `applyOp` just as the
+// library does, so that dispatch is the only difference.
+namespace {
+
+class VirtualEvaluator final
+    : public exprtree::TypedExprVisitor<std::optional<int64_t>> {
+public:
+  explicit VirtualEvaluator(const Environment& environment)
+    : environment{environment}
+      { }
+
+private:
+  std::optional<int64_t>
+  visitImpl(const Literal& literal) final {
+    return literal.value;
+  }
+
+  std::optional<int64_t>
+  visitImpl(const Symbol& symbol) final {
+    return environment.get(symbol.name, symbol.hash);
+  }
+
+  std::optional<int64_t>
+  visitImpl(const Operation& operation) final {
+    auto lhs = visit(operation.lhs);
+    auto rhs = lhs ? visit(operation.rhs) : std::nullopt;
+    if (!rhs) {
+      return {};
+    }
+    return exprtree::applyOp(operation.opCode, *lhs, *rhs);
+  }
+
+  const Environment& environment;
+};
+
+
+class VirtualOpCounter final : public exprtree::ExprVisitor {
+public:
+  std::array<size_t, exprtree::DIVIDE + 1> counts{};
+
+  void
+  run(const ExprTree& tree) {
+    std::vector<const Expression*> pending;
+    if (auto* root = tree.getRoot()) {
+      pending.push_back(root);
+    }
+    while (!pending.empty()) {
+      auto* expression = pending.back();
+      pending.pop_back();
+      expression->accept(*this);
+      if (operation) {
+        pending.push_back(&operation->rhs);
+        pending.push_back(&operation->lhs);
+        operation = nullptr;
+      }
+    }
+  }
+
+private:
+  void
+  visitImpl(const Operation& found) final {
+    ++counts[found.opCode];
+    operation = &found;
+  }
+
+  const Operation* operation = nullptr;
+};
+
+}
+
+
+static void
+BM_EvaluateVirtual(benchmark::State& state) {
+  const auto& tree = packedTreeWithLeaves(static_cast<size_t>(state.range(0)));
+  Environment environment;
+  environment.set("x", 3);
+
+  for (auto _ : state) {
+    VirtualEvaluator evaluator{environment};
+    benchmark::DoNotOptimize(evaluator.visit(*tree.getRoot()));
+  }
+  state.SetItemsProcessed(state.iterations() * (2 * state.range(0) - 1));
+}
+
+
+static void
+BM_EvaluateStatic(benchmark::State& state) {
+  const auto& tree = packedTreeWithLeaves(static_cast<size_t>(state.range(0)));
+  Environment environment;
+  environment.set("x", 3);
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(evaluate(tree, environment));
+  }
+  state.SetItemsProcessed(state.iterations() * (2 * state.range(0) - 1));
+}
+
+
+static void
+BM_CountOpsVirtual(benchmark::State& state) {
+  const auto& tree = packedTreeWithLeaves(static_cast<size_t>(state.range(0)));
+
+  for (auto _ : state) {
+    VirtualOpCounter counter;
+    counter.run(tree);
+    benchmark::DoNotOptimize(counter.counts);
+  }
+  state.SetItemsProcessed(state.iterations() * (2 * state.range(0) - 1));
+}
+
+
+static void
+BM_CountOpsStatic(benchmark::State& state) {
+  const auto& tree = packedTreeWithLeaves(static_cast<size_t>(state.range(0)));
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(countOps(tree));
+  }
+  state.SetItemsProcessed(state.iterations() * (2 * state.range(0) - 1));
+}
+
+
+static void
+visitorArguments(benchmark::internal::Benchmark* benchmark) {
+  benchmark->Arg(int64_t{1} << 14)->Arg(int64_t{1} << 20);
+  benchmark->ArgName("leaves");
+  benchmark->Unit(benchmark::kMicrosecond);
+}
+
+
+BENCHMARK(BM_EvaluateVirtual)->Apply(visitorArguments);
+BENCHMARK(BM_EvaluateStatic)->Apply(visitorArguments);
+BENCHMARK(BM_CountOpsVirtual)->Apply(visitorArguments);
+BENCHMARK(BM_CountOpsStatic)->Apply(visitorArguments);
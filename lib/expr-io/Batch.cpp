@@ -0,0 +1,265 @@
+
+#include "Batch.h"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <string_view>
+#include <unordered_map>
+
+using exprtree::BatchProgram;
+using exprtree::BatchResults;
+using exprtree::Expression;
+using exprtree::OpCode;
+using exprtree::OverflowMode;
+using exprtree::Operation;
+
+
+namespace {
+
+
+// Returns the number of stack slots needed to evaluate each node when the
+// operand needing more is always evaluated first. This is the Sethi-Ullman
+// number of the node, which grows only with the logarithm of the size of the
+// tree, however unbalanced the tree is.
+std::unordered_map<const Expression*, size_t>
+countSlots(const Expression& root) {
+  std::unordered_map<const Expression*, size_t> slots;
+  std::vector<std::pair<const Expression*, bool>> work{{&root, false}};
+  while (!work.empty()) {
+    auto [expression, combining] = work.back();
+    work.pop_back();
+    if (slots.contains(expression)) {
+      continue;
+    }
+    if (expression->kind != exprtree::OPERATION) {
+      slots.emplace(expression, 1);
+      continue;
+    }
+    const auto& operation = static_cast<const Operation&>(*expression);
+    if (!combining) {
+      work.push_back({expression, true});
+      work.push_back({&operation.rhs, false});
+      work.push_back({&operation.lhs, false});
+      continue;
+    }
+    auto lhs = slots.at(&operation.lhs);
+    auto rhs = slots.at(&operation.rhs);
+    slots.emplace(expression, lhs == rhs ? lhs + 1 : std::max(lhs, rhs));
+  }
+  return slots;
+}
+
+
+// Stores one result of an operation. `result` holds the low 64 bits of the
+// exact result, `overflowed` is 1 if the exact result did not fit and 0
+// otherwise, and `saturated` is the closest int64_t to the exact result when
+// it did not fit. Everything is selected with arithmetic rather than
+// branches, so that the loops calling this still vectorize.
+template<OverflowMode Mode>
+inline void
+store(uint64_t result, uint64_t overflowed, uint64_t saturated, int64_t& out, uint8_t& valid) {
+  if constexpr (Mode == exprtree::CHECKED) {
+    valid &= static_cast<uint8_t>(overflowed ^ 1);
+  } else if constexpr (Mode == exprtree::SATURATING) {
+    auto mask = 0 - overflowed;
+    result = (result & ~mask) | (saturated & mask);
+  }
+  out = static_cast<int64_t>(result);
+}
+
+
+// Returns the int64_t furthest from zero with the sign bit of `sign`.
+inline uint64_t
+limitWithSign(uint64_t sign) {
+  return (sign >> 63) + static_cast<uint64_t>(std::numeric_limits<int64_t>::max());
+}
+
+
+// Each operation is a plain loop over a block. Sums and differences are
+// computed in unsigned arithmetic, and they overflowed exactly when the sign
+// of the result differs from the signs that the operands imply, which is
+// found with bitwise operations rather than __builtin_add_overflow so that
+// the loops vectorize even on baseline SSE2. There is no 64 bit vector
+// multiply to vectorize products with, so they use __builtin_mul_overflow.
+// Division marks the rows that have no result and divides them by one
+// instead.
+template<OverflowMode Mode>
+void
+apply(OpCode opCode, const int64_t* lhs, const int64_t* rhs, int64_t* out,
+      uint8_t* valid, size_t count) {
+  switch (opCode) {
+    case exprtree::ADD:
+      for (size_t i = 0; i < count; ++i) {
+        auto l = static_cast<uint64_t>(lhs[i]);
+        auto r = static_cast<uint64_t>(rhs[i]);
+        auto result = l + r;
+        store<Mode>(result, ((l ^ result) & (r ^ result)) >> 63, limitWithSign(l),
+                    out[i], valid[i]);
+      }
+      break;
+    case exprtree::SUBTRACT:
+      for (size_t i = 0; i < count; ++i) {
+        auto l = static_cast<uint64_t>(lhs[i]);
+        auto r = static_cast<uint64_t>(rhs[i]);
+        auto result = l - r;
+        store<Mode>(result, ((l ^ r) & (l ^ result)) >> 63, limitWithSign(l),
+                    out[i], valid[i]);
+      }
+      break;
+    case exprtree::MULTIPLY:
+      for (size_t i = 0; i < count; ++i) {
+        int64_t result;
+        bool overflowed = __builtin_mul_overflow(lhs[i], rhs[i], &result);
+        store<Mode>(static_cast<uint64_t>(result), overflowed,
+                    limitWithSign(static_cast<uint64_t>(lhs[i] ^ rhs[i])), out[i], valid[i]);
+      }
+      break;
+    case exprtree::DIVIDE:
+      for (size_t i = 0; i < count; ++i) {
+        bool undefined = rhs[i] == 0
+          || (lhs[i] == std::numeric_limits<int64_t>::min() && rhs[i] == -1);
+        valid[i] &= static_cast<uint8_t>(!undefined);
+        out[i] = lhs[i] / (undefined ? 1 : rhs[i]);
+      }
+      break;
+  }
+}
+
+
+}
+
+
+namespace exprtree {
+
+
+std::optional<BatchProgram>
+BatchProgram::compile(const ExprTree& tree, const MappedColumns& columns,
+                      OverflowMode overflow) {
+  auto* root = tree.getRoot();
+  if (!root) {
+    return {};
+  }
+
+  auto slots = countSlots(*root);
+  std::unordered_map<std::string_view, const int64_t*> symbolColumns;
+  std::vector<Step> steps;
+  std::vector<std::pair<const Expression*, bool>> work{{root, false}};
+  while (!work.empty()) {
+    auto [expression, combining] = work.back();
+    work.pop_back();
+    switch (expression->kind) {
+      case LITERAL:
+        steps.push_back({LITERAL, ADD, false,
+          static_cast<const Literal&>(*expression).value, nullptr});
+        break;
+
+      case SYMBOL: {
+        const auto& name = static_cast<const Symbol&>(*expression).name;
+        auto [found, added] = symbolColumns.try_emplace(name, nullptr);
+        if (added) {
+          auto column = columns.find(name);
+          if (!column) {
+            return {};
+          }
+          found->second = column->data();
+        }
+        steps.push_back({SYMBOL, ADD, false, 0, found->second});
+        break;
+      }
+
+      case OPERATION: {
+        const auto& operation = static_cast<const Operation&>(*expression);
+        bool rhsFirst = slots.at(&operation.rhs) > slots.at(&operation.lhs);
+        if (combining) {
+          steps.push_back({OPERATION, operation.opCode, rhsFirst, 0, nullptr});
+          break;
+        }
+        work.push_back({expression, true});
+        work.push_back({rhsFirst ? &operation.lhs : &operation.rhs, false});
+        work.push_back({rhsFirst ? &operation.rhs : &operation.lhs, false});
+        break;
+      }
+    }
+  }
+  return BatchProgram{std::move(steps), slots.at(root), columns.rowCount(), overflow};
+}
+
+
+void
+BatchProgram::run(size_t firstRow, std::span<int64_t> values, std::span<uint8_t> valid) const {
+  assert(values.size() == valid.size() && firstRow + values.size() <= rows);
+  std::vector<std::vector<int64_t>> registers(maxDepth, std::vector<int64_t>(BLOCK_SIZE));
+  std::vector<const int64_t*> stack;
+  stack.reserve(maxDepth);
+  for (size_t done = 0; done < values.size(); done += BLOCK_SIZE) {
+    auto count = std::min(BLOCK_SIZE, values.size() - done);
+    auto* blockValues = values.data() + done;
+    auto* blockValid = valid.data() + done;
+    switch (overflow) {
+      case WRAP:
+        runBlock<WRAP>(firstRow + done, count, blockValues, blockValid, registers, stack);
+        break;
+      case CHECKED:
+        runBlock<CHECKED>(firstRow + done, count, blockValues, blockValid, registers, stack);
+        break;
+      case SATURATING:
+        runBlock<SATURATING>(firstRow + done, count, blockValues, blockValid, registers, stack);
+        break;
+    }
+  }
+}
+
+
+// The stack holds, for each value computed so far, a pointer to its values
+// for the block. Symbols point straight into their columns. Every other
+// value is written to the register for its depth on the stack.
+template<OverflowMode Mode>
+void
+BatchProgram::runBlock(size_t firstRow, size_t count, int64_t* values, uint8_t* valid,
+                       std::vector<std::vector<int64_t>>& registers,
+                       std::vector<const int64_t*>& stack) const {
+  std::fill_n(valid, count, uint8_t{1});
+  stack.clear();
+  for (const auto& step : steps) {
+    switch (step.kind) {
+      case LITERAL: {
+        auto* out = registers[stack.size()].data();
+        std::fill_n(out, count, step.value);
+        stack.push_back(out);
+        break;
+      }
+      case SYMBOL:
+        stack.push_back(step.column + firstRow);
+        break;
+      case OPERATION: {
+        auto* second = stack.back();
+        stack.pop_back();
+        auto* first = stack.back();
+        stack.pop_back();
+        auto* out = registers[stack.size()].data();
+        apply<Mode>(step.opCode, step.rhsFirst ? second : first, step.rhsFirst ? first : second,
+              out, valid, count);
+        stack.push_back(out);
+        break;
+      }
+    }
+  }
+  std::copy_n(stack.back(), count, values);
+}
+
+
+std::optional<BatchResults>
+evaluateBatch(const ExprTree& tree, const MappedColumns& columns, OverflowMode overflow) {
+  auto program = BatchProgram::compile(tree, columns, overflow);
+  if (!program) {
+    return {};
+  }
+  BatchResults results{std::vector<int64_t>(program->rowCount()),
+                       std::vector<uint8_t>(program->rowCount())};
+  program->run(0, results.values, results.valid);
+  return results;
+}
+
+
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "Columns.h"
+#include "ExprOps.h"
+#include "ExprTree.h"
+
+// Evaluating one tree for many rows of saved columns is done a block of rows
+// at a time rather than a row at a time. The tree is first compiled into a
+// flat program of steps in postorder, and each step then combines whole
+// blocks of values with a simple loop that the compiler can vectorize.
+// Symbols read their values straight from the mapped columns.
+
+namespace exprtree {
+
+
+class BatchProgram {
+public:
+  // The number of rows evaluated together by each step.
+  static constexpr size_t BLOCK_SIZE = 1024;
+
+  // Compiles the tree rooted at the root of `tree` to read its symbols from
+  // `columns` and to handle overflow as `overflow` says. Returns nothing if
+  // the tree has no root or uses a symbol with no column. The columns must
+  // outlive the program, but the tree need not.
+  static std::optional<BatchProgram> compile(const ExprTree& tree, const MappedColumns& columns,
+                                             OverflowMode overflow = WRAP);
+
+  [[nodiscard]] size_t
+  rowCount() const {
+    return rows;
+  }
+
+  // Evaluates the rows from `firstRow` to `firstRow + values.size()`,
+  // storing the value of each row in `values` and whether it has one in
+  // `valid`. A row has no value if it divides by zero, overflows in
+  // division, or overflows at all when overflow is CHECKED.
+  // Both spans must be the same size. Separate ranges of rows may be
+  // evaluated by separate threads at once.
+  void run(size_t firstRow, std::span<int64_t> values, std::span<uint8_t> valid) const;
+
+private:
+  struct Step {
+    ExprKind kind;
+    OpCode opCode;
+    // Whether the right operand was evaluated before the left, so that it is
+    // the lower of the two on the stack.
+    bool rhsFirst;
+    int64_t value;
+    const int64_t* column;
+  };
+
+  BatchProgram(std::vector<Step> steps, size_t maxDepth, size_t rows, OverflowMode overflow)
+    : steps{std::move(steps)},
+      maxDepth{maxDepth},
+      rows{rows},
+      overflow{overflow}
+      { }
+
+  template<OverflowMode Mode>
+  void runBlock(size_t firstRow, size_t count, int64_t* values, uint8_t* valid,
+                std::vector<std::vector<int64_t>>& registers,
+                std::vector<const int64_t*>& stack) const;
+
+  std::vector<Step> steps;
+  size_t maxDepth;
+  size_t rows;
+  OverflowMode overflow;
+};
+
+
+struct BatchResults {
+  std::vector<int64_t> values;
+  std::vector<uint8_t> valid;
+};
+
+
+// Evaluates `tree` for every row of `columns`. Returns nothing if the tree
+// cannot be compiled against the columns.
+[[nodiscard]] std::optional<BatchResults>
+evaluateBatch(const ExprTree& tree, const MappedColumns& columns, OverflowMode overflow = WRAP);
+
+
+}
@@ -0,0 +1,185 @@
+
+#include "Columns.h"
+
+#include <cassert>
+#include <cstring>
+#include <fstream>
+
+using exprtree::ColumnRecord;
+using exprtree::ColumnsHeader;
+using exprtree::LoadError;
+using exprtree::MappedColumns;
+using exprtree::MappedFile;
+
+
+namespace {
+
+
+constexpr size_t
+alignUp(size_t offset) {
+  return (offset + exprtree::COLUMN_ALIGNMENT - 1) & ~(exprtree::COLUMN_ALIGNMENT - 1);
+}
+
+
+// The checksum covers the column table and name pool, which immediately
+// follow the header.
+uint64_t
+metadataChecksum(std::span<const std::byte> bytes, const ColumnsHeader& header) {
+  auto size = header.columnCount * sizeof(ColumnRecord) + header.namePoolSize;
+  return exprtree::checksum(bytes.subspan(sizeof(ColumnsHeader), size));
+}
+
+
+}
+
+
+namespace exprtree {
+
+
+std::vector<std::byte>
+serializeColumns(std::span<const std::string> names,
+                 std::span<const std::vector<int64_t>> columns) {
+  assert(names.size() == columns.size());
+  size_t rowCount = columns.empty() ? 0 : columns.front().size();
+
+  ColumnsHeader header{};
+  header.magic = COLUMNS_MAGIC;
+  header.version = COLUMNS_VERSION;
+  header.rowCount = rowCount;
+  header.columnCount = columns.size();
+
+  std::vector<ColumnRecord> records;
+  std::string pool;
+  for (const auto& name : names) {
+    records.push_back({static_cast<uint32_t>(pool.size()), static_cast<uint32_t>(name.size()), 0});
+    pool += name;
+  }
+  header.namePoolSize = pool.size();
+
+  auto end = sizeof(ColumnsHeader) + records.size() * sizeof(ColumnRecord) + pool.size();
+  for (auto& record : records) {
+    record.dataOffset = alignUp(end);
+    end = record.dataOffset + rowCount * sizeof(int64_t);
+  }
+
+  // Padding between the parts of the file is left as zeros.
+  std::vector<std::byte> bytes(end);
+  auto* out = bytes.data() + sizeof(ColumnsHeader);
+  if (!records.empty()) {
+    std::memcpy(out, records.data(), records.size() * sizeof(ColumnRecord));
+  }
+  out += records.size() * sizeof(ColumnRecord);
+  if (!pool.empty()) {
+    std::memcpy(out, pool.data(), pool.size());
+  }
+  for (size_t i = 0; i < columns.size(); ++i) {
+    assert(columns[i].size() == rowCount);
+    if (rowCount != 0) {
+      std::memcpy(bytes.data() + records[i].dataOffset, columns[i].data(),
+                  rowCount * sizeof(int64_t));
+    }
+  }
+
+  header.checksum = metadataChecksum(bytes, header);
+  std::memcpy(bytes.data(), &header, sizeof(header));
+  return bytes;
+}
+
+
+bool
+saveColumns(const std::string& path,
+            std::span<const std::string> names,
+            std::span<const std::vector<int64_t>> columns) {
+  auto bytes = serializeColumns(names, columns);
+  std::ofstream out{path, std::ios::binary | std::ios::trunc};
+  out.write(reinterpret_cast<const char*>(bytes.data()),
+            static_cast<std::streamsize>(bytes.size()));
+  return static_cast<bool>(out.flush());
+}
+
+
+MappedColumns
+MappedColumns::open(const std::string& path) {
+  auto file = MappedFile::open(path);
+  if (!file.isOpen()) {
+    return MappedColumns{CANNOT_OPEN};
+  }
+  auto bytes = file.bytes();
+  return load(std::move(file), bytes);
+}
+
+
+MappedColumns
+MappedColumns::view(std::span<const std::byte> bytes) {
+  return load(MappedFile{}, bytes);
+}
+
+
+MappedColumns
+MappedColumns::load(MappedFile file, std::span<const std::byte> bytes) {
+  if (bytes.size() < sizeof(ColumnsHeader)) {
+    return MappedColumns{TRUNCATED};
+  }
+  if (reinterpret_cast<uintptr_t>(bytes.data()) % alignof(ColumnsHeader) != 0) {
+    return MappedColumns{MALFORMED};
+  }
+
+  const auto& header = *reinterpret_cast<const ColumnsHeader*>(bytes.data());
+  if (header.magic != COLUMNS_MAGIC) {
+    return MappedColumns{BAD_MAGIC};
+  }
+  if (header.version != COLUMNS_VERSION) {
+    return MappedColumns{UNSUPPORTED_VERSION};
+  }
+
+  auto available = bytes.size() - sizeof(ColumnsHeader);
+  if (header.columnCount > available / sizeof(ColumnRecord)
+      || header.namePoolSize > available - header.columnCount * sizeof(ColumnRecord)
+      || header.rowCount > bytes.size() / sizeof(int64_t)) {
+    return MappedColumns{TRUNCATED};
+  }
+  if (metadataChecksum(bytes, header) != header.checksum) {
+    return MappedColumns{BAD_CHECKSUM};
+  }
+
+  std::span records{
+    reinterpret_cast<const ColumnRecord*>(bytes.data() + sizeof(ColumnsHeader)),
+    header.columnCount};
+  std::string_view names{
+    reinterpret_cast<const char*>(bytes.data() + sizeof(ColumnsHeader) + records.size_bytes()),
+    header.namePoolSize};
+  auto columnBytes = header.rowCount * sizeof(int64_t);
+  for (const auto& record : records) {
+    if (record.nameOffset > names.size() || record.nameLength > names.size() - record.nameOffset) {
+      return MappedColumns{MALFORMED};
+    }
+    if (record.dataOffset % alignof(int64_t) != 0) {
+      return MappedColumns{MALFORMED};
+    }
+    if (record.dataOffset > bytes.size() || columnBytes > bytes.size() - record.dataOffset) {
+      return MappedColumns{TRUNCATED};
+    }
+  }
+
+  MappedColumns columns{LOADED};
+  columns.file = std::move(file);
+  columns.base = bytes.data();
+  columns.records = records;
+  columns.names = names;
+  columns.rows = header.rowCount;
+  return columns;
+}
+
+
+std::optional<std::span<const int64_t>>
+MappedColumns::find(std::string_view name) const {
+  for (size_t column = 0; column < records.size(); ++column) {
+    if (this->name(column) == name) {
+      return values(column);
+    }
+  }
+  return {};
+}
+
+
+}
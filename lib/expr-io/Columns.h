@@ -0,0 +1,137 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ExprIO.h"
+#include "MappedFile.h"
+
+// Many assignments of values to the same symbols can be saved as columns, one
+// per symbol, and used in place for batch evaluation. Row i of the file
+// assigns each symbol the i-th value of its column.
+//
+// A file holds, in order,
+//
+//   a header        identifying the format and version, giving the number of
+//                   rows and columns, the size of the name pool, and a
+//                   checksum of the column table and name pool
+//   a column table  of fixed size records giving the name of each column and
+//                   the offset of its values in the file
+//   a name pool     holding the names of the columns
+//   the columns     each `rowCount` little endian int64_t values, starting
+//                   on a COLUMN_ALIGNMENT byte boundary
+//
+// Only the table and names are checked when a file is loaded. The values are
+// left untouched until they are used, so that mapping a large file costs
+// nothing until it is read.
+
+namespace exprtree {
+
+
+inline constexpr std::array<char, 8> COLUMNS_MAGIC = {'E','X','P','R','C','O','L','S'};
+inline constexpr uint32_t COLUMNS_VERSION = 1;
+inline constexpr size_t COLUMN_ALIGNMENT = 64;
+
+
+struct ColumnsHeader {
+  std::array<char, 8> magic;
+  uint32_t version;
+  uint32_t flags;
+  uint64_t rowCount;
+  uint64_t columnCount;
+  uint64_t namePoolSize;
+  uint64_t checksum;
+};
+
+
+struct ColumnRecord {
+  uint32_t nameOffset;
+  uint32_t nameLength;
+  // The offset of the first value from the start of the file.
+  uint64_t dataOffset;
+};
+
+static_assert(sizeof(ColumnsHeader) == 48 && sizeof(ColumnRecord) == 16);
+
+
+// Returns the saved form of the columns named `names`, where `columns[i]`
+// holds the values of `names[i]`. Every column must have the same length.
+[[nodiscard]] std::vector<std::byte>
+serializeColumns(std::span<const std::string> names,
+                 std::span<const std::vector<int64_t>> columns);
+
+
+// Saves columns to the file at `path`, returning whether it succeeded.
+[[nodiscard]] bool
+saveColumns(const std::string& path,
+            std::span<const std::string> names,
+            std::span<const std::vector<int64_t>> columns);
+
+
+// Saved columns used in place.
+class MappedColumns {
+public:
+  // Maps and validates the file at `path`.
+  static MappedColumns open(const std::string& path);
+
+  // Validates and uses `bytes` in place. The bytes must outlive the result
+  // and must be aligned for a ColumnsHeader.
+  static MappedColumns view(std::span<const std::byte> bytes);
+
+  // Columns that failed to load have no rows or columns and report why.
+  [[nodiscard]] LoadError
+  getError() const {
+    return error;
+  }
+
+  [[nodiscard]] size_t
+  rowCount() const {
+    return rows;
+  }
+
+  [[nodiscard]] size_t
+  columnCount() const {
+    return records.size();
+  }
+
+  [[nodiscard]] std::string_view
+  name(size_t column) const {
+    return names.substr(records[column].nameOffset, records[column].nameLength);
+  }
+
+  [[nodiscard]] std::span<const int64_t>
+  values(size_t column) const {
+    return {reinterpret_cast<const int64_t*>(base + records[column].dataOffset), rows};
+  }
+
+  // Returns the values of the column named `name`, if there is one.
+  [[nodiscard]] std::optional<std::span<const int64_t>> find(std::string_view name) const;
+
+private:
+  explicit MappedColumns(LoadError error)
+    : file{},
+      base{nullptr},
+      records{},
+      names{},
+      rows{0},
+      error{error}
+      { }
+
+  static MappedColumns load(MappedFile file, std::span<const std::byte> bytes);
+
+  MappedFile file;
+  const std::byte* base;
+  std::span<const ColumnRecord> records;
+  std::string_view names;
+  size_t rows;
+  LoadError error;
+};
+
+
+}
@@ -0,0 +1,333 @@
+
+#include "ExprIO.h"
+
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+
+#include "ExprOps.h"
+
+using exprtree::Environment;
+using exprtree::ExprTree;
+using exprtree::Expression;
+using exprtree::FileHeader;
+using exprtree::LoadError;
+using exprtree::MappedExprTree;
+using exprtree::MappedFile;
+using exprtree::NodeRecord;
+
+
+namespace {
+
+
+// Builds the node table and string pool by walking the tree in postorder, so
+// that operands are numbered before the operations that use them.
+class Serializer {
+public:
+  void
+  run(const Expression& root) {
+    struct Step {
+      const Expression* expression;
+      bool combining;
+    };
+    std::vector<Step> work{{&root, false}};
+    while (!work.empty()) {
+      auto [expression, combining] = work.back();
+      work.pop_back();
+      if (indices.contains(expression)) {
+        continue;
+      }
+      if (expression->kind == exprtree::OPERATION && !combining) {
+        const auto& operation = static_cast<const exprtree::Operation&>(*expression);
+        work.push_back({expression, true});
+        work.push_back({&operation.rhs, false});
+        work.push_back({&operation.lhs, false});
+        continue;
+      }
+      indices.emplace(expression, static_cast<uint32_t>(records.size()));
+      records.push_back(record(*expression));
+    }
+  }
+
+  std::vector<NodeRecord> records;
+  std::string strings;
+
+private:
+  NodeRecord
+  record(const Expression& expression) {
+    return visit(expression, exprtree::overloaded{
+      [] (const exprtree::Literal& literal) {
+        return NodeRecord{exprtree::LITERAL, 0, 0, 0, static_cast<uint64_t>(literal.value)};
+      },
+      [this] (const exprtree::Symbol& symbol) {
+        auto [found, added] = names.try_emplace(symbol.name, static_cast<uint32_t>(strings.size()));
+        if (added) {
+          strings += symbol.name;
+        }
+        return NodeRecord{exprtree::SYMBOL, 0, 0, found->second, symbol.name.size()};
+      },
+      [this] (const exprtree::Operation& operation) {
+        return NodeRecord{exprtree::OPERATION, operation.opCode, 0,
+          indices.at(&operation.lhs), indices.at(&operation.rhs)};
+      },
+    });
+  }
+
+  std::unordered_map<const Expression*, uint32_t> indices;
+  std::unordered_map<std::string, uint32_t> names;
+};
+
+
+template<class T>
+void
+append(std::vector<std::byte>& bytes, std::span<const T> values) {
+  auto raw = std::as_bytes(values);
+  if (raw.empty()) {
+    return;
+  }
+  auto size = bytes.size();
+  bytes.resize(size + raw.size());
+  std::memcpy(bytes.data() + size, raw.data(), raw.size());
+}
+
+
+// Checks that every record is well formed, that every operand precedes the
+// operation using it, and that the last record is the root and reaches every
+// other, so that later passes may trust the table.
+bool
+isWellFormed(std::span<const NodeRecord> nodes, size_t stringPoolSize) {
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    const auto& node = nodes[i];
+    switch (node.kind) {
+      case exprtree::LITERAL:
+        break;
+      case exprtree::SYMBOL:
+        if (node.narrow > stringPoolSize || node.wide > stringPoolSize - node.narrow) {
+          return false;
+        }
+        break;
+      case exprtree::OPERATION:
+        if (node.opCode > exprtree::DIVIDE || node.narrow >= i || node.wide >= i) {
+          return false;
+        }
+        break;
+      default:
+        return false;
+    }
+  }
+
+  // Operands come before the operations using them, so walking back from the
+  // root marks each record before the walk reaches it, if it is reachable
+  // at all.
+  std::vector<uint8_t> reachable(nodes.size());
+  if (!nodes.empty()) {
+    reachable.back() = 1;
+  }
+  for (size_t i = nodes.size(); i-- > 0;) {
+    if (!reachable[i]) {
+      return false;
+    }
+    if (nodes[i].kind == exprtree::OPERATION) {
+      reachable[nodes[i].narrow] = 1;
+      reachable[nodes[i].wide] = 1;
+    }
+  }
+  return true;
+}
+
+
+}
+
+
+namespace exprtree {
+
+
+uint64_t
+checksum(std::span<const std::byte> bytes) {
+  constexpr uint64_t OFFSET_BASIS = 14695981039346656037ull;
+  constexpr uint64_t PRIME = 1099511628211ull;
+
+  uint64_t hash = OFFSET_BASIS;
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= bytes.size(); i += sizeof(uint64_t)) {
+    uint64_t word;
+    std::memcpy(&word, bytes.data() + i, sizeof(word));
+    hash = (hash ^ word) * PRIME;
+  }
+  if (i < bytes.size()) {
+    uint64_t word = 0;
+    std::memcpy(&word, bytes.data() + i, bytes.size() - i);
+    hash = (hash ^ word) * PRIME;
+  }
+  return hash;
+}
+
+
+std::vector<std::byte>
+serialize(const ExprTree& tree) {
+  Serializer serializer;
+  if (auto* root = tree.getRoot()) {
+    serializer.run(*root);
+  }
+
+  FileHeader header{};
+  header.magic = FORMAT_MAGIC;
+  header.version = FORMAT_VERSION;
+  header.nodeCount = serializer.records.size();
+  header.root = serializer.records.empty() ? NO_ROOT : serializer.records.size() - 1;
+  header.stringPoolSize = serializer.strings.size();
+
+  std::vector<std::byte> bytes;
+  bytes.reserve(sizeof(FileHeader) + serializer.records.size() * sizeof(NodeRecord)
+                + serializer.strings.size());
+  append(bytes, std::span<const FileHeader>{&header, 1});
+  append(bytes, std::span<const NodeRecord>{serializer.records});
+  append(bytes, std::span<const char>{serializer.strings});
+
+  header.checksum = checksum(std::span{bytes}.subspan(sizeof(FileHeader)));
+  std::memcpy(bytes.data() + offsetof(FileHeader, checksum),
+              &header.checksum, sizeof(header.checksum));
+  return bytes;
+}
+
+
+bool
+save(const ExprTree& tree, const std::string& path) {
+  auto bytes = serialize(tree);
+  std::ofstream out{path, std::ios::binary | std::ios::trunc};
+  out.write(reinterpret_cast<const char*>(bytes.data()),
+            static_cast<std::streamsize>(bytes.size()));
+  return static_cast<bool>(out.flush());
+}
+
+
+MappedExprTree
+MappedExprTree::open(const std::string& path) {
+  auto file = MappedFile::open(path);
+  if (!file.isOpen()) {
+    return MappedExprTree{CANNOT_OPEN};
+  }
+  auto bytes = file.bytes();
+  return load(std::move(file), bytes);
+}
+
+
+MappedExprTree
+MappedExprTree::view(std::span<const std::byte> bytes) {
+  return load(MappedFile{}, bytes);
+}
+
+
+MappedExprTree
+MappedExprTree::load(MappedFile file, std::span<const std::byte> bytes) {
+  if (bytes.size() < sizeof(FileHeader)) {
+    return MappedExprTree{TRUNCATED};
+  }
+  if (reinterpret_cast<uintptr_t>(bytes.data()) % alignof(FileHeader) != 0) {
+    return MappedExprTree{MALFORMED};
+  }
+
+  const auto& header = *reinterpret_cast<const FileHeader*>(bytes.data());
+  if (header.magic != FORMAT_MAGIC) {
+    return MappedExprTree{BAD_MAGIC};
+  }
+  if (header.version != FORMAT_VERSION) {
+    return MappedExprTree{UNSUPPORTED_VERSION};
+  }
+
+  auto body = bytes.subspan(sizeof(FileHeader));
+  auto maxNodes = body.size() / sizeof(NodeRecord);
+  if (header.nodeCount > maxNodes
+      || header.stringPoolSize != body.size() - header.nodeCount * sizeof(NodeRecord)) {
+    return MappedExprTree{TRUNCATED};
+  }
+  if (checksum(body) != header.checksum) {
+    return MappedExprTree{BAD_CHECKSUM};
+  }
+
+  std::span nodes{reinterpret_cast<const NodeRecord*>(body.data()), header.nodeCount};
+  std::string_view strings{
+    reinterpret_cast<const char*>(body.data() + nodes.size_bytes()), header.stringPoolSize};
+  bool hasValidRoot = header.root == NO_ROOT
+    ? nodes.empty()
+    : header.root == nodes.size() - 1 && nodes.size() <= UINT32_MAX;
+  if (!hasValidRoot || !isWellFormed(nodes, strings.size())) {
+    return MappedExprTree{MALFORMED};
+  }
+
+  MappedExprTree tree{LOADED};
+  tree.file = std::move(file);
+  tree.nodes = nodes;
+  tree.strings = strings;
+  tree.root = header.root;
+  tree.hashes.resize(nodes.size());
+  for (NodeRef node = 0; node < nodes.size(); ++node) {
+    if (tree.kind(node) == SYMBOL) {
+      tree.hashes[node] = hashName(tree.name(node));
+    }
+  }
+  return tree;
+}
+
+
+void
+MappedExprTree::materialize(ExprTree& tree) const {
+  std::vector<const Expression*> copies;
+  copies.reserve(nodes.size());
+  for (NodeRef node = 0; node < nodes.size(); ++node) {
+    switch (kind(node)) {
+      case LITERAL:
+        copies.push_back(&tree.addLiteral(value(node)));
+        break;
+      case SYMBOL:
+        copies.push_back(&tree.addSymbol(std::string{name(node)}));
+        break;
+      case OPERATION:
+        copies.push_back(&tree.addOperation(opCode(node),
+          *copies[successor(node, 0)], *copies[successor(node, 1)]));
+        break;
+    }
+  }
+  if (auto start = entry()) {
+    tree.setRoot(*copies[*start]);
+  }
+}
+
+
+std::optional<int64_t>
+evaluate(const MappedExprTree& tree, const Environment& environment, OverflowMode overflow) {
+  auto root = tree.entry();
+  if (!root) {
+    return {};
+  }
+
+  // Loading checked that every saved node is reachable from the root, so any
+  // node that cannot be evaluated means the whole tree cannot be.
+  auto nodes = tree.records();
+  std::vector<int64_t> values(nodes.size());
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    const auto& node = nodes[i];
+    std::optional<int64_t> value;
+    switch (node.kind) {
+      case LITERAL:
+        value = static_cast<int64_t>(node.wide);
+        break;
+      case SYMBOL:
+        value = environment.get(tree.name(static_cast<uint32_t>(i)),
+                                tree.symbolHash(static_cast<uint32_t>(i)));
+        break;
+      case OPERATION:
+        value = applyOp(static_cast<OpCode>(node.opCode), values[node.narrow], values[node.wide],
+                        overflow);
+        break;
+    }
+    if (!value) {
+      return {};
+    }
+    values[i] = *value;
+  }
+  return values[*root];
+}
+
+
+}
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ExprOps.h"
+#include "ExprTree.h"
+#include "MappedFile.h"
+
+// Trees can be saved in a compact binary format and used again later straight
+// from the bytes of the file, without rebuilding them node by node.
+//
+// A file holds, in order,
+//
+//   a header        identifying the format and version, giving the number of
+//                   nodes, the index of the root, the size of the string
+//                   pool, and a checksum of everything after the header
+//   a node table    of fixed size records, in which operations refer to their
+//                   operands by index. Every operand comes before the
+//                   operations that use it, so one forward pass over the
+//                   table visits operands before operations.
+//   a string pool   holding the name of each distinct symbol once
+//
+// All values are little endian. Only nodes reachable from the root are
+// saved, the root is the last of them, and shared subexpressions remain
+// shared. Loading rejects files that break any of these rules.
+
+namespace exprtree {
+
+
+static_assert(std::endian::native == std::endian::little,
+  "Saved trees are used in place, which requires a little endian host");
+
+
+inline constexpr std::array<char, 8> FORMAT_MAGIC = {'E','X','P','R','T','R','E','E'};
+inline constexpr uint32_t FORMAT_VERSION = 1;
+inline constexpr uint64_t NO_ROOT = UINT64_MAX;
+
+
+struct FileHeader {
+  std::array<char, 8> magic;
+  uint32_t version;
+  uint32_t flags;
+  uint64_t nodeCount;
+  uint64_t root;
+  uint64_t stringPoolSize;
+  uint64_t checksum;
+};
+
+
+// The meaning of the fields of a record depends on its kind.
+//
+//   LITERAL     `wide` holds the bits of the value
+//   SYMBOL      `narrow` is the offset of the name in the string pool and
+//               `wide` is its length
+//   OPERATION   `narrow` is the index of the left operand and `wide` the
+//               index of the right operand
+struct NodeRecord {
+  uint8_t kind;
+  uint8_t opCode;
+  uint16_t reserved;
+  uint32_t narrow;
+  uint64_t wide;
+};
+
+static_assert(sizeof(FileHeader) == 48 && sizeof(NodeRecord) == 16);
+
+
+// A 64 bit FNV-1a hash taken over little endian words rather than bytes, which
+// is several times faster for the large inputs it checks. A trailing partial
+// word is padded with zeros.
+[[nodiscard]] uint64_t checksum(std::span<const std::byte> bytes);
+
+
+// Returns the saved form of the part of `tree` reachable from its root.
+[[nodiscard]] std::vector<std::byte> serialize(const ExprTree& tree);
+
+
+// Saves `tree` to the file at `path`, returning whether it succeeded.
+[[nodiscard]] bool save(const ExprTree& tree, const std::string& path);
+
+
+enum LoadError : uint8_t {
+  LOADED,
+  CANNOT_OPEN,
+  TRUNCATED,
+  BAD_MAGIC,
+  UNSUPPORTED_VERSION,
+  BAD_CHECKSUM,
+  MALFORMED
+};
+
+
+// A saved tree used in place. The node table and string pool are read
+// directly from the underlying bytes, which may come from a memory mapped
+// file, so loading costs one validation pass and no allocation per node.
+// Loading also hashes each symbol's name once, so that evaluation never
+// does.
+//
+// A loaded tree is also a graph in the sense of Traversal.h, with nodes
+// identified by their indices, so it can be traversed without conversion.
+class MappedExprTree {
+public:
+  using NodeRef = uint32_t;
+
+  static constexpr bool mayShare = true;
+
+  // Maps and validates the file at `path`.
+  static MappedExprTree open(const std::string& path);
+
+  // Validates and uses `bytes` in place. The bytes must outlive the result
+  // and must be aligned for a FileHeader.
+  static MappedExprTree view(std::span<const std::byte> bytes);
+
+  // A tree that failed to load has no nodes and reports why.
+  [[nodiscard]] LoadError
+  getError() const {
+    return error;
+  }
+
+  [[nodiscard]] size_t
+  size() const {
+    return nodes.size();
+  }
+
+  [[nodiscard]] std::optional<NodeRef>
+  entry() const {
+    if (root == NO_ROOT) {
+      return {};
+    }
+    return {static_cast<NodeRef>(root)};
+  }
+
+  [[nodiscard]] size_t
+  successorCount(NodeRef node) const {
+    return kind(node) == OPERATION ? 2 : 0;
+  }
+
+  [[nodiscard]] NodeRef
+  successor(NodeRef node, size_t index) const {
+    return static_cast<NodeRef>(index == 0 ? nodes[node].narrow : nodes[node].wide);
+  }
+
+  [[nodiscard]] ExprKind
+  kind(NodeRef node) const {
+    return static_cast<ExprKind>(nodes[node].kind);
+  }
+
+  [[nodiscard]] int64_t
+  value(NodeRef node) const {
+    return static_cast<int64_t>(nodes[node].wide);
+  }
+
+  [[nodiscard]] std::string_view
+  name(NodeRef node) const {
+    return strings.substr(nodes[node].narrow, nodes[node].wide);
+  }
+
+  // The hash of the name of a symbol, as computed by `hashName`.
+  [[nodiscard]] uint64_t
+  symbolHash(NodeRef node) const {
+    return hashes[node];
+  }
+
+  [[nodiscard]] OpCode
+  opCode(NodeRef node) const {
+    return static_cast<OpCode>(nodes[node].opCode);
+  }
+
+  // The records of all nodes, with operands before the operations using them.
+  [[nodiscard]] std::span<const NodeRecord>
+  records() const {
+    return nodes;
+  }
+
+  // Adds an equivalent copy of the saved nodes to `tree` and makes it the
+  // root, for code that needs an `ExprTree`.
+  void materialize(ExprTree& tree) const;
+
+private:
+  explicit MappedExprTree(LoadError error)
+    : file{},
+      nodes{},
+      strings{},
+      root{NO_ROOT},
+      hashes{},
+      error{error}
+      { }
+
+  static MappedExprTree load(MappedFile file, std::span<const std::byte> bytes);
+
+  MappedFile file;
+  std::span<const NodeRecord> nodes;
+  std::string_view strings;
+  uint64_t root;
+  std::vector<uint64_t> hashes;
+  LoadError error;
+};
+
+
+// Evaluates a saved tree in place with a single forward pass over its nodes.
+[[nodiscard]] std::optional<int64_t>
+evaluate(const MappedExprTree& tree, const Environment& environment,
+         OverflowMode overflow = WRAP);
+
+
+}
@@ -0,0 +1,178 @@
+
+#include "ExprStream.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <istream>
+
+#include "Lines.h"
+
+using exprtree::ExprStream;
+using exprtree::ExprTree;
+using exprtree::Notation;
+using exprtree::ReadStatus;
+using exprtree::detail::isBlank;
+
+
+namespace {
+
+
+// Reads up to `capacity` characters from `in` without waiting for more than
+// it needs. Whatever the stream already has buffered is taken at once. When
+// it has nothing, this waits for input only until the end of the next line,
+// so that a line that is already complete is never held back until the
+// producer writes more or closes the stream.
+size_t
+readAvailable(std::istream& in, char* destination, size_t capacity) {
+  auto count = static_cast<size_t>(in.readsome(destination, static_cast<std::streamsize>(capacity)));
+  if (count > 0 || !in.good()) {
+    return count;
+  }
+
+  auto& source = *in.rdbuf();
+  while (count < capacity) {
+    auto next = source.sbumpc();
+    if (next == std::istream::traits_type::eof()) {
+      in.setstate(std::ios::eofbit);
+      break;
+    }
+    destination[count++] = static_cast<char>(next);
+    if (next == '\n') {
+      break;
+    }
+    // Waiting for one character may have brought in many more.
+    if (source.in_avail() > 0) {
+      count += static_cast<size_t>(in.readsome(destination + count,
+                                               static_cast<std::streamsize>(capacity - count)));
+      break;
+    }
+  }
+  return count;
+}
+
+
+}
+
+
+ExprStream::ExprStream(int fd, Notation notation, size_t chunkSize)
+  : fd{fd},
+    in{nullptr},
+    parser{notation},
+    buffer(std::max<size_t>(chunkSize, 1)),
+    begin{0},
+    end{0},
+    exhausted{false},
+    failed{false},
+    offset{0},
+    line{1},
+    error{}
+    { }
+
+
+ExprStream::ExprStream(std::istream& in, Notation notation, size_t chunkSize)
+  : fd{-1},
+    in{&in},
+    parser{notation},
+    buffer(std::max<size_t>(chunkSize, 1)),
+    begin{0},
+    end{0},
+    exhausted{false},
+    failed{false},
+    offset{0},
+    line{1},
+    error{}
+    { }
+
+
+ReadStatus
+ExprStream::next(ExprTree& tree) {
+  auto lineOffset = offset;
+  auto lineNumber = line;
+  auto text = nextLine(lineOffset, lineNumber);
+  if (!text) {
+    return failed ? READ_ERROR : END_OF_INPUT;
+  }
+
+  tree.clear();
+  if (parser.parse(*text, tree)) {
+    return EXPRESSION;
+  }
+  error = parser.getError();
+  error.offset += lineOffset;
+  error.line = lineNumber;
+  return SYNTAX_ERROR;
+}
+
+
+std::optional<std::string_view>
+ExprStream::nextLine(size_t& lineOffset, size_t& lineNumber) {
+  while (true) {
+    const char* start = buffer.data() + begin;
+    std::string_view text;
+    size_t consumed;
+    if (auto* newline = static_cast<const char*>(std::memchr(start, '\n', end - begin))) {
+      text = {start, static_cast<size_t>(newline - start)};
+      consumed = text.size() + 1;
+    } else if (refill()) {
+      continue;
+    } else if (failed || begin == end) {
+      return {};
+    } else {
+      text = {start, end - begin};
+      consumed = text.size();
+    }
+
+    // The line stays in the buffer until the next refill, which only happens
+    // on a later call, so it is safe to return a view of it.
+    lineOffset = offset;
+    lineNumber = line;
+    begin += consumed;
+    offset += consumed;
+    ++line;
+    if (!isBlank(text)) {
+      return text;
+    }
+  }
+}
+
+
+bool
+ExprStream::refill() {
+  if (exhausted) {
+    return false;
+  }
+
+  // Keep the partial line at the front of the buffer, and only grow the
+  // buffer when a single line fills all of it.
+  std::memmove(buffer.data(), buffer.data() + begin, end - begin);
+  end -= begin;
+  begin = 0;
+  if (end == buffer.size()) {
+    buffer.resize(buffer.size() * 2);
+  }
+
+  auto* destination = buffer.data() + end;
+  auto available = buffer.size() - end;
+  size_t count = 0;
+  if (in) {
+    count = readAvailable(*in, destination, available);
+    failed = in->bad();
+  } else {
+    ssize_t result;
+    do {
+      result = ::read(fd, destination, available);
+    } while (result < 0 && errno == EINTR);
+    failed = result < 0;
+    count = failed ? 0 : static_cast<size_t>(result);
+  }
+
+  if (count == 0 || failed) {
+    exhausted = true;
+    return false;
+  }
+  end += count;
+  return true;
+}
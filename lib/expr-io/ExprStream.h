@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "ExprOps.h"
+#include "ExprTree.h"
+#include "Parser.h"
+
+// A stream of expressions holds one expression per line, as in
+//
+//   3 * x + 1
+//   (y - 2) / x
+//
+// Streams are read a chunk at a time, so they may be far larger than memory.
+// Lines holding only whitespace are skipped, and the last line need not end
+// with a newline.
+
+namespace exprtree {
+
+
+enum ReadStatus : uint8_t {
+  // An expression was parsed into the tree.
+  EXPRESSION,
+  // The current line is not a valid expression. The error is available from
+  // the stream, and reading may continue with the next line.
+  SYNTAX_ERROR,
+  END_OF_INPUT,
+  // The underlying file or stream failed.
+  READ_ERROR
+};
+
+
+// Reads the expressions of a stream one at a time from either a file
+// descriptor or a `std::istream`. Only the current chunk of input is held in
+// memory, growing only for lines longer than a chunk, and parsing reuses the
+// same scratch space for every line.
+class ExprStream {
+public:
+  static constexpr size_t DEFAULT_CHUNK_SIZE = 64 * 1024;
+
+  // Reads from `fd`, which remains owned by the caller.
+  explicit ExprStream(int fd,
+                      Notation notation = INFIX,
+                      size_t chunkSize = DEFAULT_CHUNK_SIZE);
+
+  explicit ExprStream(std::istream& in,
+                      Notation notation = INFIX,
+                      size_t chunkSize = DEFAULT_CHUNK_SIZE);
+
+  // Clears `tree` and parses the next expression of the stream into it.
+  // Clearing keeps the memory of the old nodes, so reading a long stream into
+  // one tree holds memory flat.
+  ReadStatus next(ExprTree& tree);
+
+  // The error for the most recent SYNTAX_ERROR. Its offset and line are
+  // positions within the whole stream rather than within the line.
+  [[nodiscard]] const ParseError&
+  getError() const {
+    return error;
+  }
+
+private:
+  // Returns the next line that is not blank, without its newline, along with
+  // its position in the stream.
+  std::optional<std::string_view> nextLine(size_t& lineOffset, size_t& lineNumber);
+
+  // Reads more input after the unconsumed part of the buffer, returning false
+  // at the end of the input or on failure.
+  bool refill();
+
+  int fd;
+  std::istream* in;
+  Parser parser;
+  std::vector<char> buffer;
+  size_t begin;
+  size_t end;
+  bool exhausted;
+  bool failed;
+  // The position in the stream of `buffer[begin]`, as a byte offset and a
+  // line number.
+  size_t offset;
+  size_t line;
+  ParseError error;
+};
+
+
+// Reads each expression from `stream` in turn and calls `f` with the tree and
+// its value in `environment`. Stops early at a syntax or read error and
+// returns the status, so that a caller may report the error and call again
+// to continue with the following line. Otherwise returns END_OF_INPUT.
+template<class F>
+ReadStatus
+evaluateEach(ExprStream& stream, const Environment& environment, F&& f) {
+  ExprTree tree;
+  while (true) {
+    auto status = stream.next(tree);
+    if (status != EXPRESSION) {
+      return status;
+    }
+    f(static_cast<const ExprTree&>(tree), evaluate(tree, environment));
+  }
+}
+
+
+}
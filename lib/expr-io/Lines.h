@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string_view>
+
+namespace exprtree {
+namespace detail {
+
+
+// Whether `line` holds nothing but whitespace. Readers skip such lines
+// wherever the lines come from.
+inline bool
+isBlank(std::string_view line) {
+  return line.find_first_not_of(" \t\r") == std::string_view::npos;
+}
+
+
+}
+}
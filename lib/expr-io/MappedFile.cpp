@@ -0,0 +1,73 @@
+
+#include "MappedFile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <utility>
+
+using exprtree::MappedFile;
+
+
+MappedFile
+MappedFile::open(const std::string& path) {
+  MappedFile file;
+  int descriptor = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (descriptor < 0) {
+    return file;
+  }
+
+  struct stat status;
+  if (::fstat(descriptor, &status) == 0 && status.st_size >= 0) {
+    auto size = static_cast<size_t>(status.st_size);
+    if (size == 0) {
+      file.opened = true;
+    } else if (void* mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+               mapped != MAP_FAILED) {
+      file.address = static_cast<const std::byte*>(mapped);
+      file.size = size;
+      file.opened = true;
+    }
+  }
+
+  // The mapping stays valid after the descriptor is closed.
+  ::close(descriptor);
+  return file;
+}
+
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+  : address{std::exchange(other.address, nullptr)},
+    size{std::exchange(other.size, 0)},
+    opened{std::exchange(other.opened, false)}
+    { }
+
+
+MappedFile&
+MappedFile::operator=(MappedFile&& other) noexcept {
+  if (this != &other) {
+    unmap();
+    address = std::exchange(other.address, nullptr);
+    size = std::exchange(other.size, 0);
+    opened = std::exchange(other.opened, false);
+  }
+  return *this;
+}
+
+
+MappedFile::~MappedFile() {
+  unmap();
+}
+
+
+void
+MappedFile::unmap() {
+  if (address) {
+    ::munmap(const_cast<std::byte*>(address), size);
+  }
+  address = nullptr;
+  size = 0;
+  opened = false;
+}
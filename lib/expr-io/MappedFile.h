@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string>
+
+namespace exprtree {
+
+
+// A read only, memory mapped view of a whole file. The contents are paged in
+// by the operating system as they are touched, so large files can be used in
+// place without first being read into memory.
+class MappedFile {
+public:
+  MappedFile() = default;
+
+  // Maps the file at `path`. On failure, the result is not open.
+  static MappedFile open(const std::string& path);
+
+  MappedFile(MappedFile&& other) noexcept;
+  MappedFile& operator=(MappedFile&& other) noexcept;
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  [[nodiscard]] bool
+  isOpen() const {
+    return opened;
+  }
+
+  [[nodiscard]] std::span<const std::byte>
+  bytes() const {
+    return {address, size};
+  }
+
+private:
+  void unmap();
+
+  const std::byte* address = nullptr;
+  size_t size = 0;
+  bool opened = false;
+};
+
+
+}
@@ -0,0 +1,182 @@
+
+#include "ParallelParse.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <utility>
+
+#include "Lines.h"
+#include "MappedFile.h"
+
+using exprtree::ParallelParseOptions;
+using exprtree::ParsedChunk;
+using exprtree::Parser;
+using exprtree::detail::isBlank;
+
+
+namespace {
+
+
+// Returns the first piece of `text` of about `targetSize` bytes, which ends
+// just after a newline or at the end of the text.
+std::string_view
+firstChunk(std::string_view text, size_t targetSize) {
+  auto end = std::min(targetSize, text.size());
+  if (end < text.size()) {
+    auto newline = text.find('\n', end - 1);
+    end = newline == std::string_view::npos ? text.size() : newline + 1;
+  }
+  return text.substr(0, end);
+}
+
+
+// A chunk being parsed ahead of the consumer. `done` is set once the task
+// parsing it has finished.
+struct ChunkSlot {
+  ParsedChunk parsed;
+  size_t lineCount = 0;
+  std::atomic<bool> done = false;
+};
+
+
+// Parses one chunk that starts at `chunkOffset` within the whole input, with
+// error lines counted from the first line of the chunk.
+void
+parseChunk(std::string_view chunk, size_t chunkOffset, exprtree::Notation notation,
+           ChunkSlot& slot) {
+  auto& parsed = slot.parsed;
+  parsed.tree.clear();
+  parsed.roots.clear();
+  parsed.errors.clear();
+  slot.lineCount = 0;
+
+  Parser parser{notation};
+  size_t offset = 0;
+  while (offset < chunk.size()) {
+    const char* start = chunk.data() + offset;
+    auto* newline = static_cast<const char*>(std::memchr(start, '\n', chunk.size() - offset));
+    size_t length = newline ? static_cast<size_t>(newline - start) : chunk.size() - offset;
+    std::string_view line{start, length};
+    ++slot.lineCount;
+
+    if (!isBlank(line)) {
+      // Nodes built before an error stay in the tree, but nothing refers to
+      // them, and they go when the tree is cleared for the next chunk.
+      auto* root = parser.parse(line, parsed.tree);
+      parsed.roots.push_back(root);
+      if (!root) {
+        auto error = parser.getError();
+        error.offset += chunkOffset + offset;
+        error.line = slot.lineCount;
+        parsed.errors.push_back(error);
+      }
+    }
+    offset += length + 1;
+  }
+}
+
+
+}
+
+
+namespace exprtree {
+
+
+void
+parseLines(std::string_view text,
+           traversal::WorkStealingPool& pool,
+           const std::function<void(ParsedChunk&)>& consume,
+           const ParallelParseOptions& options) {
+  auto targetSize = std::max<size_t>(1,
+    std::min(options.chunkSize, text.size() / (4 * pool.size()) + 1));
+
+  // Chunks are parsed into a fixed ring of slots, and the slot of a chunk is
+  // given to the next one to be split off once the consumer is done with it.
+  // The slots outlive the tasks, which the group waits for.
+  std::vector<ChunkSlot> slots(4 * pool.size());
+  traversal::TaskGroup tasks{pool};
+  size_t splitOffset = 0;
+  auto startNext = [&] (ChunkSlot& slot) {
+    if (splitOffset == text.size()) {
+      return false;
+    }
+    auto chunk = firstChunk(text.substr(splitOffset), targetSize);
+    slot.done.store(false, std::memory_order_relaxed);
+    tasks.spawn([chunk, chunkOffset = splitOffset, notation = options.notation, &slot] {
+      parseChunk(chunk, chunkOffset, notation, slot);
+      slot.done.store(true, std::memory_order_release);
+      slot.done.notify_one();
+    });
+    splitOffset += chunk.size();
+    return true;
+  };
+
+  size_t started = 0;
+  while (started < slots.size() && startNext(slots[started])) {
+    ++started;
+  }
+
+  size_t linesBefore = 0;
+  for (size_t next = 0; next < started; ++next) {
+    auto& slot = slots[next % slots.size()];
+    while (!slot.done.load(std::memory_order_acquire)) {
+      if (!pool.runOne()) {
+        slot.done.wait(false, std::memory_order_acquire);
+      }
+    }
+    for (auto& error : slot.parsed.errors) {
+      error.line += linesBefore;
+    }
+    linesBefore += slot.lineCount;
+    consume(slot.parsed);
+    if (startNext(slot)) {
+      ++started;
+    }
+  }
+}
+
+
+std::vector<ParsedChunk>
+parseLines(std::string_view text,
+           traversal::WorkStealingPool& pool,
+           const ParallelParseOptions& options) {
+  std::vector<ParsedChunk> chunks;
+  parseLines(text, pool, [&chunks] (ParsedChunk& chunk) {
+    chunks.push_back(std::move(chunk));
+  }, options);
+  return chunks;
+}
+
+
+bool
+parseFile(const std::string& path,
+          traversal::WorkStealingPool& pool,
+          const std::function<void(ParsedChunk&)>& consume,
+          const ParallelParseOptions& options) {
+  auto file = MappedFile::open(path);
+  if (!file.isOpen()) {
+    return false;
+  }
+  auto bytes = file.bytes();
+  parseLines({reinterpret_cast<const char*>(bytes.data()), bytes.size()}, pool, consume, options);
+  return true;
+}
+
+
+std::optional<std::vector<ParsedChunk>>
+parseFile(const std::string& path,
+          traversal::WorkStealingPool& pool,
+          const ParallelParseOptions& options) {
+  std::vector<ParsedChunk> chunks;
+  auto opened = parseFile(path, pool, [&chunks] (ParsedChunk& chunk) {
+    chunks.push_back(std::move(chunk));
+  }, options);
+  if (!opened) {
+    return {};
+  }
+  return chunks;
+}
+
+
+}
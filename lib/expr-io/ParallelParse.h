@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ExprTree.h"
+#include "Parser.h"
+#include "WorkStealingPool.h"
+
+// Large files of newline separated expressions, in the same form read by
+// ExprStream.h, can also be parsed by many threads at once. The input is
+// split into chunks at line boundaries, and each chunk is parsed by a
+// separate task into a tree of its own. Chunks are handed to a consumer in
+// input order while later chunks are still being parsed, so, as with
+// ExprStream.h, the input may be far larger than memory.
+
+namespace exprtree {
+
+
+struct ParallelParseOptions {
+  Notation notation = INFIX;
+  // The approximate number of bytes parsed by each task. Chunks are always
+  // extended to the end of a line, and inputs large enough to share are split
+  // into at least a few chunks per worker.
+  size_t chunkSize = 1 << 20;
+};
+
+
+// The expressions parsed from one chunk of the input. The nodes of all of
+// them are kept in the one tree, so a chunk of many short lines costs only a
+// few allocations.
+struct ParsedChunk {
+  ExprTree tree;
+  // The root of the expression on each line of the chunk that is not blank,
+  // in input order, or nullptr for a line that could not be parsed. Make one
+  // of them the root of `tree` to use it with functions that take a tree.
+  std::vector<const Expression*> roots;
+  // Errors for the lines that could not be parsed, in input order, with
+  // positions within the whole input.
+  std::vector<ParseError> errors;
+};
+
+
+// Parses every line of `text` using the workers of `pool` and passes each
+// chunk to `consume` on the calling thread, in input order. Only a few chunks
+// per worker are parsed ahead of the consumer, and the chunk passed to it is
+// reused for a later one once it returns, so anything to be kept must be
+// moved out of it.
+void
+parseLines(std::string_view text,
+           traversal::WorkStealingPool& pool,
+           const std::function<void(ParsedChunk&)>& consume,
+           const ParallelParseOptions& options = {});
+
+
+// Parses every line of `text` using the workers of `pool`, and keeps every
+// chunk.
+[[nodiscard]] std::vector<ParsedChunk>
+parseLines(std::string_view text,
+           traversal::WorkStealingPool& pool,
+           const ParallelParseOptions& options = {});
+
+
+// Maps the file at `path` and parses every line of it as `parseLines` does.
+// Returns false if the file cannot be opened.
+bool
+parseFile(const std::string& path,
+          traversal::WorkStealingPool& pool,
+          const std::function<void(ParsedChunk&)>& consume,
+          const ParallelParseOptions& options = {});
+
+
+// Maps the file at `path` and parses every line of it, keeping every chunk.
+// Returns nothing if the file cannot be opened.
+[[nodiscard]] std::optional<std::vector<ParsedChunk>>
+parseFile(const std::string& path,
+          traversal::WorkStealingPool& pool,
+          const ParallelParseOptions& options = {});
+
+
+}
@@ -0,0 +1,351 @@
+
+#include "Parser.h"
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <string>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using exprtree::ExprTree;
+using exprtree::Expression;
+using exprtree::OpCode;
+using exprtree::ParseError;
+using exprtree::Parser;
+
+
+namespace {
+
+
+constexpr bool
+isDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+
+constexpr bool
+isIdentifierStart(char c) {
+  auto lower = static_cast<char>(c | 0x20);
+  return (lower >= 'a' && lower <= 'z') || c == '_';
+}
+
+
+constexpr bool
+isIdentifierChar(char c) {
+  return isIdentifierStart(c) || isDigit(c);
+}
+
+
+constexpr bool
+isSpace(char c) {
+  return c == ' ' || c == '\n' || c == '\t' || c == '\r';
+}
+
+
+#if defined(__SSE2__)
+
+// Each of these marks the bytes of a 16 byte block that belong to a class of
+// characters, agreeing exactly with the scalar tests above. Bytes outside of
+// ASCII compare as negative, so they never fall into a range.
+
+__m128i
+inRange(__m128i bytes, char low, char high) {
+  return _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8(static_cast<char>(low - 1))),
+                       _mm_cmplt_epi8(bytes, _mm_set1_epi8(static_cast<char>(high + 1))));
+}
+
+
+__m128i
+digitBytes(__m128i bytes) {
+  return inRange(bytes, '0', '9');
+}
+
+
+__m128i
+identifierBytes(__m128i bytes) {
+  auto lower = _mm_or_si128(bytes, _mm_set1_epi8(0x20));
+  return _mm_or_si128(_mm_or_si128(inRange(lower, 'a', 'z'), digitBytes(bytes)),
+                      _mm_cmpeq_epi8(bytes, _mm_set1_epi8('_')));
+}
+
+
+__m128i
+spaceBytes(__m128i bytes) {
+  return _mm_or_si128(
+    _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(' ')),
+                 _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n'))),
+    _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\t')),
+                 _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\r'))));
+}
+
+#endif
+
+
+// Returns the position just past the run of characters starting at `position`
+// that satisfy `inClass`. Where SSE2 is available, `inClassVector` classifies
+// 16 bytes at a time, so long literals, names, and indentation are skipped
+// with a few instructions. The tail of the text, and targets without SSE2,
+// fall back to checking one byte at a time.
+template<class ScalarClass, class VectorClass>
+size_t
+scanRun(std::string_view text, size_t position,
+        ScalarClass inClass, [[maybe_unused]] VectorClass inClassVector) {
+  // Most tokens are short, so a single byte check first avoids a vector load
+  // for the common case of a one character token or a single space.
+  if (position + 1 < text.size() && !inClass(text[position + 1])) {
+    return inClass(text[position]) ? position + 1 : position;
+  }
+#if defined(__SSE2__)
+  while (position + 16 <= text.size()) {
+    auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + position));
+    auto mask = static_cast<unsigned>(_mm_movemask_epi8(inClassVector(bytes)));
+    if (mask != 0xFFFF) {
+      return position + static_cast<size_t>(std::countr_one(mask));
+    }
+    position += 16;
+  }
+#endif
+  while (position < text.size() && inClass(text[position])) {
+    ++position;
+  }
+  return position;
+}
+
+
+#if defined(__SSE2__)
+#define CLASSIFIER(name) [] (__m128i bytes) { return name(bytes); }
+#else
+#define CLASSIFIER(name) nullptr
+#endif
+
+
+size_t
+skipSpaces(std::string_view text, size_t position) {
+  return scanRun(text, position, isSpace, CLASSIFIER(spaceBytes));
+}
+
+
+size_t
+scanDigits(std::string_view text, size_t position) {
+  return scanRun(text, position, isDigit, CLASSIFIER(digitBytes));
+}
+
+
+size_t
+scanIdentifier(std::string_view text, size_t position) {
+  return scanRun(text, position, isIdentifierChar, CLASSIFIER(identifierBytes));
+}
+
+
+#undef CLASSIFIER
+
+
+std::optional<OpCode>
+asOperator(char c) {
+  switch (c) {
+    case '+': return exprtree::ADD;
+    case '-': return exprtree::SUBTRACT;
+    case '*': return exprtree::MULTIPLY;
+    case '/': return exprtree::DIVIDE;
+    default:  return {};
+  }
+}
+
+
+int
+precedence(OpCode opCode) {
+  return opCode == exprtree::MULTIPLY || opCode == exprtree::DIVIDE ? 2 : 1;
+}
+
+
+bool
+startsLiteral(std::string_view text, size_t position) {
+  return isDigit(text[position])
+    || (text[position] == '-' && position + 1 < text.size() && isDigit(text[position + 1]));
+}
+
+
+// Reads the literal or symbol that starts at `position`, if there is one, and
+// adds it to the tree. On success, `position` is moved past the operand.
+struct OperandReader {
+  std::string_view text;
+  ExprTree& tree;
+  const char* error = nullptr;
+
+  const Expression*
+  read(size_t& position) {
+    if (startsLiteral(text, position)) {
+      auto end = scanDigits(text, text[position] == '-' ? position + 1 : position);
+      int64_t value = 0;
+      auto [last, status] = std::from_chars(text.data() + position, text.data() + end, value);
+      if (status != std::errc{} || last != text.data() + end) {
+        error = "integer literal is out of range";
+        return nullptr;
+      }
+      position = end;
+      return &tree.addLiteral(value);
+    }
+    if (isIdentifierStart(text[position])) {
+      auto end = scanIdentifier(text, position);
+      auto name = text.substr(position, end - position);
+      position = end;
+      return &tree.addSymbol(std::string{name});
+    }
+    error = "expected an operand";
+    return nullptr;
+  }
+};
+
+
+}
+
+
+namespace exprtree {
+
+
+const Expression*
+Parser::parse(std::string_view text, ExprTree& tree) {
+  operands.clear();
+  operators.clear();
+  error = {};
+  auto* root = notation == PREFIX ? parsePrefix(text, tree) : parseInfix(text, tree);
+  if (root) {
+    tree.setRoot(*root);
+  }
+  return root;
+}
+
+
+const Expression*
+Parser::parseInfix(std::string_view text, ExprTree& tree) {
+  auto reduce = [this, &tree] {
+    auto opCode = operators.back().opCode;
+    operators.pop_back();
+    auto* rhs = operands.back();
+    operands.pop_back();
+    operands.back() = &tree.addOperation(opCode, *operands.back(), *rhs);
+  };
+
+  OperandReader reader{text, tree};
+  bool expectOperand = true;
+  size_t position = skipSpaces(text, 0);
+  while (position < text.size()) {
+    char c = text[position];
+    if (expectOperand) {
+      if (c == '(') {
+        operators.push_back({true, ADD, position, nullptr});
+        ++position;
+      } else if (auto* operand = reader.read(position)) {
+        operands.push_back(operand);
+        expectOperand = false;
+      } else {
+        return fail(text, position, reader.error);
+      }
+
+    } else if (auto opCode = asOperator(c)) {
+      while (!operators.empty() && !operators.back().isParenthesis
+             && precedence(operators.back().opCode) >= precedence(*opCode)) {
+        reduce();
+      }
+      operators.push_back({false, *opCode, position, nullptr});
+      expectOperand = true;
+      ++position;
+
+    } else if (c == ')') {
+      while (!operators.empty() && !operators.back().isParenthesis) {
+        reduce();
+      }
+      if (operators.empty()) {
+        return fail(text, position, "unmatched ')'");
+      }
+      operators.pop_back();
+      ++position;
+
+    } else {
+      return fail(text, position, "expected an operator");
+    }
+    position = skipSpaces(text, position);
+  }
+
+  if (expectOperand) {
+    return fail(text, text.size(), "expected an operand");
+  }
+  while (!operators.empty()) {
+    if (operators.back().isParenthesis) {
+      return fail(text, operators.back().offset, "unclosed '('");
+    }
+    reduce();
+  }
+  return operands.back();
+}
+
+
+const Expression*
+Parser::parsePrefix(std::string_view text, ExprTree& tree) {
+  OperandReader reader{text, tree};
+  const Expression* root = nullptr;
+  size_t position = skipSpaces(text, 0);
+  while (position < text.size()) {
+    if (root) {
+      return fail(text, position, "expected the end of the expression");
+    }
+
+    auto opCode = asOperator(text[position]);
+    if (opCode && !startsLiteral(text, position)) {
+      operators.push_back({false, *opCode, position, nullptr});
+      position = skipSpaces(text, position + 1);
+      continue;
+    }
+
+    auto* operand = reader.read(position);
+    if (!operand) {
+      return fail(text, position, reader.error);
+    }
+    // Each completed operand either becomes the left operand of the innermost
+    // pending operator, or completes it and is folded into the next one out.
+    while (operand && !operators.empty()) {
+      auto& pending = operators.back();
+      if (!pending.lhs) {
+        pending.lhs = operand;
+        operand = nullptr;
+      } else {
+        operand = &tree.addOperation(pending.opCode, *pending.lhs, *operand);
+        operators.pop_back();
+      }
+    }
+    root = operand;
+    position = skipSpaces(text, position);
+  }
+
+  if (!root) {
+    return fail(text, text.size(), "expected an operand");
+  }
+  return root;
+}
+
+
+const Expression*
+Parser::fail(std::string_view text, size_t offset, const char* message) {
+  auto before = text.substr(0, offset);
+  auto line = static_cast<size_t>(std::count(before.begin(), before.end(), '\n')) + 1;
+  auto lineStart = before.rfind('\n');
+  auto column = lineStart == std::string_view::npos ? offset + 1 : offset - lineStart;
+  error = {offset, line, column, message};
+  return nullptr;
+}
+
+
+std::optional<ParseError>
+parse(std::string_view text, ExprTree& tree, Notation notation) {
+  Parser parser{notation};
+  if (!parser.parse(text, tree)) {
+    return parser.getError();
+  }
+  return {};
+}
+
+
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "ExprTree.h"
+
+// Expressions can be read from text in either of two notations.
+//
+//   INFIX    3 * x + 1, with the usual precedence of * and / over + and -,
+//            left associativity, and parentheses for grouping
+//   PREFIX   + * 3 x 1, where every operator is followed by its two operands
+//
+// Literals are decimal 64 bit integers and may be negative, as in -5. A minus
+// sign directly followed by a digit where an operand is expected starts a
+// literal; anywhere else it is subtraction. Symbols are identifiers made of
+// letters, digits, and underscores that do not start with a digit. Tokens may
+// be separated by any whitespace, including newlines.
+
+namespace exprtree {
+
+
+enum Notation : uint8_t {
+  INFIX,
+  PREFIX
+};
+
+
+struct ParseError {
+  // The position of the offending input, both as a byte offset from the
+  // start of the text and as a line and column, each counted from 1.
+  size_t offset;
+  size_t line;
+  size_t column;
+  const char* message;
+};
+
+
+// A `Parser` builds the nodes of expressions directly into a tree. Parsing is
+// iterative rather than recursive descent, and the scratch space it needs,
+// its stacks included, is kept between calls so that parsing many
+// expressions with one parser does not allocate for each of them.
+class Parser {
+public:
+  explicit Parser(Notation notation = INFIX)
+    : notation{notation},
+      operands{},
+      operators{},
+      error{}
+      { }
+
+  // Parses `text` as a single expression, adds its nodes to `tree`, and makes
+  // it the root. On failure, returns nullptr and records an error. Nodes for
+  // the part that was parsed may remain in the tree, but its root is left
+  // unchanged.
+  const Expression* parse(std::string_view text, ExprTree& tree);
+
+  [[nodiscard]] const ParseError&
+  getError() const {
+    return error;
+  }
+
+private:
+  struct PendingOperator {
+    // Open parentheses are kept on the operator stack as well.
+    bool isParenthesis;
+    OpCode opCode;
+    size_t offset;
+    // For prefix notation, the left operand once it has been parsed.
+    const Expression* lhs;
+  };
+
+  const Expression* parseInfix(std::string_view text, ExprTree& tree);
+  const Expression* parsePrefix(std::string_view text, ExprTree& tree);
+  const Expression* fail(std::string_view text, size_t offset, const char* message);
+
+  const Notation notation;
+  std::vector<const Expression*> operands;
+  std::vector<PendingOperator> operators;
+  ParseError error;
+};
+
+
+// Parses `text` as a single expression into `tree`. On success, the
+// expression becomes the root and no error is returned.
+[[nodiscard]] std::optional<ParseError>
+parse(std::string_view text, ExprTree& tree, Notation notation = INFIX);
+
+
+}
@@ -0,0 +1,171 @@
+
+#include "Printer.h"
+
+#include <charconv>
+#include <vector>
+
+using exprtree::Expression;
+using exprtree::OpCode;
+using exprtree::Operation;
+
+
+namespace {
+
+
+// Each step of printing either prints an expression or appends fixed text,
+// such as an operator or a closing parenthesis, once everything before it has
+// been printed.
+struct Step {
+  const Expression* expression;
+  std::string_view text;
+};
+
+
+constexpr std::string_view
+infixText(OpCode opCode) {
+  switch (opCode) {
+    case exprtree::ADD:      return " + ";
+    case exprtree::SUBTRACT: return " - ";
+    case exprtree::MULTIPLY: return " * ";
+    case exprtree::DIVIDE:   break;
+  }
+  return " / ";
+}
+
+
+constexpr std::string_view
+prefixText(OpCode opCode) {
+  switch (opCode) {
+    case exprtree::ADD:      return "+ ";
+    case exprtree::SUBTRACT: return "- ";
+    case exprtree::MULTIPLY: return "* ";
+    case exprtree::DIVIDE:   break;
+  }
+  return "/ ";
+}
+
+
+// Literals and symbols bind tightest, so they never need parentheses.
+int
+precedence(const Expression& expression) {
+  if (expression.kind != exprtree::OPERATION) {
+    return 3;
+  }
+  auto opCode = static_cast<const Operation&>(expression).opCode;
+  return opCode == exprtree::MULTIPLY || opCode == exprtree::DIVIDE ? 2 : 1;
+}
+
+
+void
+appendLeaf(const Expression& expression, std::string& out) {
+  if (expression.kind == exprtree::LITERAL) {
+    char digits[24];
+    auto value = static_cast<const exprtree::Literal&>(expression).value;
+    auto [end, status] = std::to_chars(digits, digits + sizeof(digits), value);
+    out.append(digits, end);
+  } else {
+    out += static_cast<const exprtree::Symbol&>(expression).name;
+  }
+}
+
+
+// Operations are printed as their operands with the operator between them.
+// Because the parser groups operators of equal precedence to the left, a
+// right operand needs parentheses when it binds no tighter than the
+// operator, while a left operand only needs them when it binds more loosely.
+void
+printInfix(const Expression& root, std::string& out) {
+  std::vector<Step> work{{&root, {}}};
+  while (!work.empty()) {
+    auto [expression, text] = work.back();
+    work.pop_back();
+    if (!expression) {
+      out += text;
+      continue;
+    }
+    if (expression->kind != exprtree::OPERATION) {
+      appendLeaf(*expression, out);
+      continue;
+    }
+
+    const auto& operation = static_cast<const Operation&>(*expression);
+    auto outer = precedence(operation);
+    bool wrapLhs = precedence(operation.lhs) < outer;
+    bool wrapRhs = precedence(operation.rhs) <= outer;
+    // Steps are pushed in reverse, so that they are taken in order.
+    if (wrapRhs) {
+      work.push_back({nullptr, ")"});
+    }
+    work.push_back({&operation.rhs, {}});
+    if (wrapRhs) {
+      work.push_back({nullptr, "("});
+    }
+    work.push_back({nullptr, infixText(operation.opCode)});
+    if (wrapLhs) {
+      work.push_back({nullptr, ")"});
+    }
+    work.push_back({&operation.lhs, {}});
+    if (wrapLhs) {
+      work.push_back({nullptr, "("});
+    }
+  }
+}
+
+
+void
+printPrefix(const Expression& root, std::string& out) {
+  std::vector<Step> work{{&root, {}}};
+  while (!work.empty()) {
+    auto [expression, text] = work.back();
+    work.pop_back();
+    if (!expression) {
+      out += text;
+      continue;
+    }
+    if (expression->kind != exprtree::OPERATION) {
+      appendLeaf(*expression, out);
+      continue;
+    }
+
+    const auto& operation = static_cast<const Operation&>(*expression);
+    out += prefixText(operation.opCode);
+    work.push_back({&operation.rhs, {}});
+    work.push_back({nullptr, " "});
+    work.push_back({&operation.lhs, {}});
+  }
+}
+
+
+}
+
+
+namespace exprtree {
+
+
+void
+print(const Expression& expression, std::string& out, Notation notation) {
+  if (notation == PREFIX) {
+    printPrefix(expression, out);
+  } else {
+    printInfix(expression, out);
+  }
+}
+
+
+void
+print(const ExprTree& tree, std::string& out, Notation notation) {
+  if (auto* root = tree.getRoot()) {
+    print(*root, out, notation);
+  }
+}
+
+
+std::string
+toString(const ExprTree& tree, Notation notation) {
+  std::string out;
+  print(tree, out, notation);
+  return out;
+}
+
+
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+
+#include "ExprTree.h"
+#include "Parser.h"
+
+// Expressions can be written back out as text in either notation understood
+// by Parser.h, and parsing the text rebuilds an expression of the same shape.
+// Infix text uses only the parentheses that precedence and left associativity
+// require, so `(3 * x) + 1` prints as `3 * x + 1` while `3 * (x + 1)` and
+// `x - (y - 1)` keep theirs. Tokens are separated by single spaces.
+//
+// Printing is iterative, so arbitrarily deep trees can be printed, and it
+// appends to a buffer owned by the caller. Reusing one buffer to print many
+// trees avoids allocating for each of them.
+
+namespace exprtree {
+
+
+// Appends the text of `expression` to `out`.
+void print(const Expression& expression, std::string& out, Notation notation = INFIX);
+
+
+// Appends the text of the root of `tree` to `out`. A tree without a root
+// prints nothing.
+void print(const ExprTree& tree, std::string& out, Notation notation = INFIX);
+
+
+[[nodiscard]] std::string toString(const ExprTree& tree, Notation notation = INFIX);
+
+
+}
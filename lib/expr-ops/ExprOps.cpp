@@ -2,36 +2,60 @@
 
 #include "ExprTree.h"
 #include "ExprOps.h"
-#include <cassert>
+#include <array>
 
-// You will want to implement these functions within this file.
-
-using exprtree::Environment;
-using exprtree::ExprVisitor;
-using exprtree::Expression;
-using exprtree::Literal;
+using exprtree::ExprTree;
 using exprtree::Operation;
 using exprtree::OpCode;
 using exprtree::Symbol;
 
-namespace exprtree {
+
+namespace {
+
+
+class SymbolCounter final : public exprtree::StaticExprVisitor<SymbolCounter> {
+public:
+  std::unordered_map<std::string,size_t> counts;
+
+  void visitSymbol(const Symbol& symbol) { ++counts[symbol.name]; }
+};
+
+
+// Opcodes are few and dense, so they are tallied in an array and only moved
+// into a map once the walk is done.
+class OpCounter final : public exprtree::StaticExprVisitor<OpCounter> {
+public:
+  std::array<size_t, exprtree::DIVIDE + 1> counts{};
+
+  void visitOperation(const Operation& operation) { ++counts[operation.opCode]; }
+};
 
 
-std::optional<int64_t>
-evaluate(const ExprTree& tree, const Environment& environment) {
-  return {};
 }
 
 
+namespace exprtree {
+
+
 std::unordered_map<std::string,size_t>
 countSymbols(const ExprTree& tree) {
-  return {};
+  SymbolCounter counter;
+  counter.walk(tree);
+  return std::move(counter.counts);
 }
 
 
 std::unordered_map<OpCode,size_t>
 countOps(const ExprTree& tree) {
-  return {};
+  OpCounter counter;
+  counter.walk(tree);
+  std::unordered_map<OpCode,size_t> counts;
+  for (size_t opCode = 0; opCode < counter.counts.size(); ++opCode) {
+    if (counter.counts[opCode] > 0) {
+      counts[static_cast<OpCode>(opCode)] = counter.counts[opCode];
+    }
+  }
+  return counts;
 }
 
 
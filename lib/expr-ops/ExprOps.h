@@ -2,9 +2,19 @@
 
 #pragma once
 
+#include <cassert>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
+
+#include "ExprTree.h"
+#include "Prefetch.h"
 
 // This file defines the core interface of the functions that you need to define
 // for expression trees.
@@ -12,8 +22,269 @@
 namespace exprtree {
 
 
-std::optional<int64_t>
-evaluate(const ExprTree& tree, const Environment& environment);
+// What addition, subtraction, and multiplication produce when the exact
+// result does not fit in an int64_t. WRAP keeps the low 64 bits of the exact
+// result, CHECKED gives no result, and SATURATING gives the closest int64_t.
+enum OverflowMode : uint8_t {
+  WRAP,
+  CHECKED,
+  SATURATING
+};
+
+
+struct EvaluationOptions {
+  // How far ahead on the evaluator's work stack to prefetch nodes. Shallow
+  // parts of a tree are evaluated by recursion instead, where any nonzero
+  // distance prefetches the operands of each operation before visiting them.
+  size_t prefetchDistance = DEFAULT_PREFETCH_DISTANCE;
+  OverflowMode overflow = WRAP;
+};
+
+
+// Evaluation accepts any environment that can look a symbol up by its name
+// and the hash of that name from `hashName`, such as `Environment` or the
+// layered environments of LayeredEnvironment.h.
+template<class Env>
+concept SymbolEnvironment = requires(const Env& environment, std::string_view name, uint64_t hash) {
+  { environment.get(name, hash) } -> std::convertible_to<std::optional<int64_t>>;
+};
+
+
+// Applies `opCode` to a pair of values, handling overflow as `Mode` says.
+// Division by zero and division that overflows have no result in every mode.
+template<OverflowMode Mode = WRAP>
+constexpr std::optional<int64_t>
+applyOp(OpCode opCode, int64_t lhs, int64_t rhs) {
+  int64_t result = 0;
+  bool overflowed = false;
+  switch (opCode) {
+    case OpCode::ADD:      overflowed = __builtin_add_overflow(lhs, rhs, &result); break;
+    case OpCode::SUBTRACT: overflowed = __builtin_sub_overflow(lhs, rhs, &result); break;
+    case OpCode::MULTIPLY: overflowed = __builtin_mul_overflow(lhs, rhs, &result); break;
+    case OpCode::DIVIDE:
+      if (rhs == 0 || (lhs == std::numeric_limits<int64_t>::min() && rhs == -1)) {
+        return {};
+      }
+      return lhs / rhs;
+  }
+  if (!overflowed || Mode == WRAP) {
+    return result;
+  }
+  if constexpr (Mode == CHECKED) {
+    return {};
+  } else {
+    // A sum or difference overflows toward the sign of `lhs`, and a product
+    // toward the sign it would have had.
+    bool negative = opCode == OpCode::MULTIPLY ? (lhs < 0) != (rhs < 0) : lhs < 0;
+    return negative ? std::numeric_limits<int64_t>::min() : std::numeric_limits<int64_t>::max();
+  }
+}
+
+
+constexpr std::optional<int64_t>
+applyOp(OpCode opCode, int64_t lhs, int64_t rhs, OverflowMode overflow) {
+  switch (overflow) {
+    case WRAP:       return applyOp<WRAP>(opCode, lhs, rhs);
+    case CHECKED:    return applyOp<CHECKED>(opCode, lhs, rhs);
+    case SATURATING: return applyOp<SATURATING>(opCode, lhs, rhs);
+  }
+  return {};
+}
+
+
+namespace detail {
+
+// The stack evaluator works bottom up from an explicit stack of work rather
+// than by recursion, so that deep trees cannot exhaust the call stack and so
+// that the expressions it will reach next are known ahead of time and can be
+// prefetched. Each step either evaluates an expression, or combines the values
+// of an operation's operands once both have been evaluated.
+template<SymbolEnvironment Env, OverflowMode Mode>
+class StackEvaluator final : public StaticExprVisitor<StackEvaluator<Env, Mode>> {
+public:
+  constexpr StackEvaluator(const Env& environment, size_t prefetchDistance)
+    : environment{environment},
+      prefetchDistance{prefetchDistance},
+      work{},
+      values{},
+      failed{false}
+      { }
+
+  constexpr std::optional<int64_t>
+  run(const Expression& root) {
+    work.push_back({&root, nullptr});
+    while (!work.empty() && !failed) {
+      auto [expression, combining] = work.back();
+      work.pop_back();
+      prefetchAhead();
+
+      if (combining) {
+        combine(*combining);
+      } else {
+        this->visit(*expression);
+      }
+    }
+
+    if (failed) {
+      return {};
+    }
+    assert(values.size() == 1 && "Evaluation must produce exactly one value");
+    return values.back();
+  }
+
+private:
+  friend StaticExprVisitor<StackEvaluator<Env, Mode>>;
+
+  struct Step {
+    const Expression* expression;
+    const Operation* combining;
+  };
+
+  constexpr void
+  visitLiteral(const Literal& literal) {
+    values.push_back(literal.value);
+  }
+
+  constexpr void
+  visitSymbol(const Symbol& symbol) {
+    auto value = environment.get(symbol.name, symbol.hash);
+    if (!value) {
+      failed = true;
+      return;
+    }
+    values.push_back(*value);
+  }
+
+  constexpr void
+  visitOperation(const Operation& operation) {
+    work.push_back({nullptr, &operation});
+    work.push_back({&operation.rhs, nullptr});
+    work.push_back({&operation.lhs, nullptr});
+  }
+
+  constexpr void
+  combine(const Operation& operation) {
+    auto rhs = values.back();
+    values.pop_back();
+    auto result = applyOp<Mode>(operation.opCode, values.back(), rhs);
+    if (!result) {
+      failed = true;
+      return;
+    }
+    values.back() = *result;
+  }
+
+  constexpr void
+  prefetchAhead() const {
+    if (prefetchDistance == 0 || work.size() < prefetchDistance) {
+      return;
+    }
+    if (auto* upcoming = work[work.size() - prefetchDistance].expression) {
+      prefetch(upcoming);
+    }
+  }
+
+  const Env& environment;
+  const size_t prefetchDistance;
+  std::vector<Step> work;
+  std::vector<int64_t> values;
+  bool failed;
+};
+
+
+// Evaluates by recursion, so that each value is returned directly to the
+// operation that needs it. Past a fixed depth, the remaining subtree is
+// handed to the stack based evaluator.
+template<SymbolEnvironment Env, OverflowMode Mode>
+class RecursiveEvaluator final : public StaticExprVisitor<RecursiveEvaluator<Env, Mode>> {
+public:
+  constexpr RecursiveEvaluator(const Env& environment, size_t prefetchDistance)
+    : environment{environment},
+      prefetchDistance{prefetchDistance},
+      depth{0}
+      { }
+
+private:
+  friend StaticExprVisitor<RecursiveEvaluator<Env, Mode>>;
+
+  static constexpr size_t MAX_RECURSION_DEPTH = 2048;
+
+  constexpr std::optional<int64_t>
+  visitLiteral(const Literal& literal) {
+    return literal.value;
+  }
+
+  constexpr std::optional<int64_t>
+  visitSymbol(const Symbol& symbol) {
+    return environment.get(symbol.name, symbol.hash);
+  }
+
+  constexpr std::optional<int64_t>
+  visitOperation(const Operation& operation) {
+    if (depth == MAX_RECURSION_DEPTH) {
+      return StackEvaluator<Env, Mode>{environment, prefetchDistance}.run(operation);
+    }
+    if (prefetchDistance > 0) {
+      prefetch(&operation.rhs);
+      prefetch(&operation.lhs);
+    }
+    ++depth;
+    auto lhs = this->visit(operation.lhs);
+    auto rhs = lhs ? this->visit(operation.rhs) : std::nullopt;
+    --depth;
+    if (!rhs) {
+      return {};
+    }
+    return applyOp<Mode>(operation.opCode, *lhs, *rhs);
+  }
+
+  const Env& environment;
+  const size_t prefetchDistance;
+  size_t depth;
+};
+
+}
+
+
+// Evaluation can be used in constant expressions, so a tree and environment
+// built at compile time can be checked and folded before the program runs.
+// The overflow mode may be fixed at compile time, as in
+// `evaluate<CHECKED>(tree, environment)`, in which case `options.overflow` is
+// ignored, or chosen at run time through the options.
+//
+// Each mode is evaluated out of line. Inlined into a caller that built the
+// tree, the evaluator lets GCC see which node the root is but not its kind
+// tag, and GCC then warns at -O2 about casting the root to the other kinds in
+// branches that never run.
+template<OverflowMode Mode, SymbolEnvironment Env>
+[[gnu::noinline]] constexpr std::optional<int64_t>
+evaluate(const ExprTree& tree, const Env& environment, EvaluationOptions options = {}) {
+  auto* root = tree.getRoot();
+  if (!root) {
+    return {};
+  }
+  detail::RecursiveEvaluator<Env, Mode> evaluator{environment, options.prefetchDistance};
+  return evaluator.visit(*root);
+}
+
+
+template<SymbolEnvironment Env>
+constexpr std::optional<int64_t>
+evaluate(const ExprTree& tree, const Env& environment, EvaluationOptions options) {
+  switch (options.overflow) {
+    case WRAP:       return evaluate<WRAP>(tree, environment, options);
+    case CHECKED:    return evaluate<CHECKED>(tree, environment, options);
+    case SATURATING: return evaluate<SATURATING>(tree, environment, options);
+  }
+  return {};
+}
+
+
+template<SymbolEnvironment Env>
+constexpr std::optional<int64_t>
+evaluate(const ExprTree& tree, const Env& environment) {
+  return evaluate(tree, environment, EvaluationOptions{});
+}
 
 
 std::unordered_map<std::string,size_t>
@@ -0,0 +1,240 @@
+#pragma once
+
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include "ExprOps.h"
+#include "ExprTree.h"
+
+// Expressions that are known in full at compile time can be written directly
+// in C++, as in
+//
+//   constexpr auto formula = lit<3>() * sym<"x">() + lit<1>();
+//
+// The structure of such an expression lives entirely in its type, so
+// evaluating it compiles to straight line code with no tree to walk, and any
+// part that does not depend on a symbol is folded at compile time. When a
+// runtime tree is needed, `materialize` builds an equivalent `ExprTree`.
+
+namespace exprtree {
+
+
+// A string literal that can be passed as a template argument, so that the
+// name of a symbol can be part of a type.
+template<size_t N>
+struct FixedString {
+  constexpr FixedString(const char (&literal)[N]) {
+    std::copy_n(literal, N, chars);
+  }
+
+  [[nodiscard]] constexpr std::string_view
+  view() const {
+    return {chars, N - 1};
+  }
+
+  char chars[N] = {};
+};
+
+
+template<class Expr>
+inline constexpr bool IS_STATIC_EXPRESSION = false;
+
+template<class Expr>
+concept StaticExpression = IS_STATIC_EXPRESSION<std::remove_cvref_t<Expr>>;
+
+
+// An environment for static expressions only needs to look names up. Both
+// `Environment` and simple constexpr lookups defined by callers qualify.
+template<class Env>
+concept StaticEnvironment =
+  requires(const Env& environment, std::string_view name) {
+    { environment.get(name) } -> std::convertible_to<std::optional<int64_t>>;
+  }
+  || requires(const Env& environment, const std::string& name) {
+    { environment.get(name) } -> std::convertible_to<std::optional<int64_t>>;
+  };
+
+
+// The value of an expression that does not depend on any symbol, computed
+// once at compile time.
+template<StaticExpression Expr>
+inline constexpr std::optional<int64_t> FOLDED_VALUE = Expr::evaluate();
+
+
+template<int64_t Value>
+struct StaticLiteral {
+  static constexpr bool IS_CONSTANT = true;
+
+  static constexpr std::optional<int64_t>
+  evaluate() {
+    return Value;
+  }
+
+  template<StaticEnvironment Env>
+  static constexpr std::optional<int64_t>
+  evaluate(const Env& /*environment*/) {
+    return Value;
+  }
+
+  static const Expression&
+  materialize(ExprTree& tree) {
+    return tree.addLiteral(Value);
+  }
+};
+
+
+template<FixedString Name>
+struct StaticSymbol {
+  static constexpr bool IS_CONSTANT = false;
+
+  static constexpr std::string_view
+  name() {
+    return Name.view();
+  }
+
+  template<StaticEnvironment Env>
+  static constexpr std::optional<int64_t>
+  evaluate(const Env& environment) {
+    if constexpr (requires { environment.get(name(), uint64_t{}); }) {
+      constexpr uint64_t HASH = hashName(name());
+      return environment.get(name(), HASH);
+    } else if constexpr (requires { environment.get(name()); }) {
+      return environment.get(name());
+    } else {
+      return environment.get(std::string{name()});
+    }
+  }
+
+  static const Expression&
+  materialize(ExprTree& tree) {
+    return tree.addSymbol(std::string{name()});
+  }
+};
+
+
+template<OpCode Code, StaticExpression Lhs, StaticExpression Rhs>
+struct StaticOperation {
+  static constexpr bool IS_CONSTANT = Lhs::IS_CONSTANT && Rhs::IS_CONSTANT;
+
+  static constexpr std::optional<int64_t>
+  evaluate() requires IS_CONSTANT {
+    auto lhs = Lhs::evaluate();
+    auto rhs = Rhs::evaluate();
+    if (!lhs || !rhs) {
+      return {};
+    }
+    return applyOp(Code, *lhs, *rhs);
+  }
+
+  template<StaticEnvironment Env>
+  static constexpr std::optional<int64_t>
+  evaluate(const Env& environment) {
+    if constexpr (IS_CONSTANT) {
+      return FOLDED_VALUE<StaticOperation>;
+    } else {
+      auto lhs = Lhs::evaluate(environment);
+      if (!lhs) {
+        return {};
+      }
+      auto rhs = Rhs::evaluate(environment);
+      if (!rhs) {
+        return {};
+      }
+      return applyOp(Code, *lhs, *rhs);
+    }
+  }
+
+  static const Expression&
+  materialize(ExprTree& tree) {
+    const auto& lhs = Lhs::materialize(tree);
+    const auto& rhs = Rhs::materialize(tree);
+    return tree.addOperation(Code, lhs, rhs);
+  }
+};
+
+
+template<int64_t Value>
+inline constexpr bool IS_STATIC_EXPRESSION<StaticLiteral<Value>> = true;
+
+template<FixedString Name>
+inline constexpr bool IS_STATIC_EXPRESSION<StaticSymbol<Name>> = true;
+
+template<OpCode Code, class Lhs, class Rhs>
+inline constexpr bool IS_STATIC_EXPRESSION<StaticOperation<Code, Lhs, Rhs>> = true;
+
+
+template<int64_t Value>
+constexpr StaticLiteral<Value>
+lit() {
+  return {};
+}
+
+
+template<FixedString Name>
+constexpr StaticSymbol<Name>
+sym() {
+  return {};
+}
+
+
+template<StaticExpression Lhs, StaticExpression Rhs>
+constexpr StaticOperation<ADD, std::remove_cvref_t<Lhs>, std::remove_cvref_t<Rhs>>
+operator+(Lhs&&, Rhs&&) {
+  return {};
+}
+
+
+template<StaticExpression Lhs, StaticExpression Rhs>
+constexpr StaticOperation<SUBTRACT, std::remove_cvref_t<Lhs>, std::remove_cvref_t<Rhs>>
+operator-(Lhs&&, Rhs&&) {
+  return {};
+}
+
+
+template<StaticExpression Lhs, StaticExpression Rhs>
+constexpr StaticOperation<MULTIPLY, std::remove_cvref_t<Lhs>, std::remove_cvref_t<Rhs>>
+operator*(Lhs&&, Rhs&&) {
+  return {};
+}
+
+
+template<StaticExpression Lhs, StaticExpression Rhs>
+constexpr StaticOperation<DIVIDE, std::remove_cvref_t<Lhs>, std::remove_cvref_t<Rhs>>
+operator/(Lhs&&, Rhs&&) {
+  return {};
+}
+
+
+// Evaluates a static expression that does not depend on any symbol. The
+// result is always computed at compile time.
+template<StaticExpression Expr>
+constexpr std::optional<int64_t>
+evaluate(const Expr& /*expression*/) requires std::remove_cvref_t<Expr>::IS_CONSTANT {
+  return FOLDED_VALUE<std::remove_cvref_t<Expr>>;
+}
+
+
+template<StaticExpression Expr, StaticEnvironment Env>
+constexpr std::optional<int64_t>
+evaluate(const Expr& /*expression*/, const Env& environment) {
+  return std::remove_cvref_t<Expr>::evaluate(environment);
+}
+
+
+// Adds the nodes of `expression` to `tree` and makes them its root.
+template<StaticExpression Expr>
+const Expression&
+materialize(const Expr& /*expression*/, ExprTree& tree) {
+  const auto& root = std::remove_cvref_t<Expr>::materialize(tree);
+  tree.setRoot(root);
+  return root;
+}
+
+
+}
@@ -2,12 +2,23 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <cstddef>
 #include <cstdint>
-#include <deque>
+#include <memory>
+#include <new>
 #include <optional>
+#include <span>
 #include <string>
+#include <string_view>
 #include <type_traits>
-#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Prefetch.h"
 
 namespace exprtree {
 
@@ -49,12 +60,54 @@ private:
 // ways. The way that it is handled in LLVM is quite different from how it is
 // solved in Antlr.
 //
+// The kinds of expression form a closed set, so every expression records
+// which kind it is. Dispatching on this tag lets `visit` select the handler
+// for a node with a switch that the compiler can inline, rather than through
+// virtual calls.
+enum ExprKind : uint8_t {
+  LITERAL,
+  SYMBOL,
+  OPERATION
+};
+
+
 class Expression {
 public:
-  virtual void accept(ExprVisitor& visitor) const = 0;
+  // Dispatches to the matching `visit` overload of `visitor`. This is built
+  // on the free function `visit` below and needs no virtual call of its own.
+  void accept(ExprVisitor& visitor) const;
+
+  const ExprKind kind;
+
+  // Scratch space for passes that need to mark the nodes they have reached,
+  // such as traversals that must recognize shared subexpressions. A pass
+  // stamps nodes with an epoch from `newEpoch()`, so marks left by earlier
+  // passes never need to be cleared.
+  mutable uint64_t epoch = 0;
+
+protected:
+  constexpr explicit Expression(ExprKind kind)
+    : kind{kind}
+      { }
 };
 
 
+// Returns the first of `count` consecutive epochs, none of which any previous
+// call has returned. Every epoch returned later is larger than all of them.
+[[nodiscard]] inline uint64_t
+newEpochs(uint64_t count) {
+  static std::atomic<uint64_t> last{0};
+  return last.fetch_add(count, std::memory_order_relaxed) + 1;
+}
+
+
+// Returns an epoch that no previous call has returned.
+[[nodiscard]] inline uint64_t
+newEpoch() {
+  return newEpochs(1);
+}
+
+
 // A `Literal` expresses a value that is known ahead of type and represented
 // syntactically within an expression. It represents the value with which it
 // is initialized.
@@ -63,16 +116,28 @@ public:
 //
 class Literal final : public Expression {
 public:
-  explicit Literal(int64_t value)
-    : value{value}
+  constexpr explicit Literal(int64_t value)
+    : Expression{LITERAL},
+      value{value}
       { }
 
-  void accept(ExprVisitor& visitor) const final { return visitor.visit(*this); }
-
   const int64_t value;
 };
 
 
+// Returns the 64 bit FNV-1a hash of a symbol name. Environments index their
+// bindings by this hash, and every Symbol computes it once when it is
+// created, so evaluation can look names up without hashing them again.
+constexpr uint64_t
+hashName(std::string_view name) {
+  uint64_t hash = 14695981039346656037ull;
+  for (char c : name) {
+    hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+  }
+  return hash;
+}
+
+
 // A `Symbol` represents a named value that is not known ahead of time within
 // an expression. A binding between a Symbol and the value it represents may
 // be provided in an Environment. By looking up the symbol in the environment,
@@ -82,13 +147,20 @@ public:
 //
 class Symbol final : public Expression {
 public:
-  explicit Symbol(std::string name)
-    : name{std::move(name)}
+  constexpr explicit Symbol(std::string name)
+    : Expression{SYMBOL},
+      name{std::move(name)},
+      hash{hashName(this->name)}
       { }
 
-  void accept(ExprVisitor& visitor) const final { return visitor.visit(*this); }
+  constexpr explicit Symbol(std::string_view name)
+    : Expression{SYMBOL},
+      name{name},
+      hash{hashName(name)}
+      { }
 
   const std::string name;
+  const uint64_t hash;
 };
 
 
@@ -104,29 +176,271 @@ enum OpCode : uint8_t {
 // an internal node of the expression tree.
 class Operation final : public Expression {
 public:
-  Operation(OpCode opCode, const Expression& lhs, const Expression& rhs)
-    : opCode{opCode},
+  constexpr Operation(OpCode opCode, const Expression& lhs, const Expression& rhs)
+    : Expression{OPERATION},
+      opCode{opCode},
       lhs{lhs},
       rhs{rhs}
       { }
 
-  void accept(ExprVisitor& visitor) const final { return visitor.visit(*this); }
-
   const OpCode opCode;
   const Expression& lhs;
   const Expression& rhs;
 };
 
 
+// Storage for nodes of one kind that never moves a node once it has been
+// created, so that nodes may safely refer to one another. Nodes are
+// allocated in chunks, much like a std::deque, but the store can also be used
+// in constant expressions. Each chunk is twice the size of the one before, so
+// the many small trees of a large input stay small, while a large tree still
+// needs only a few dozen allocations.
+template<class Node>
+class NodeStore {
+public:
+  constexpr NodeStore() = default;
+
+  NodeStore(const NodeStore&) = delete;
+  NodeStore& operator=(const NodeStore&) = delete;
+
+  constexpr NodeStore(NodeStore&& other) noexcept
+    : chunks{std::move(other.chunks)},
+      count{std::exchange(other.count, 0)}
+      { }
+
+  constexpr NodeStore&
+  operator=(NodeStore&& other) noexcept {
+    clear();
+    chunks = std::move(other.chunks);
+    count = std::exchange(other.count, 0);
+    return *this;
+  }
+
+  constexpr ~NodeStore() { clear(); }
+
+  template<class... Args>
+  constexpr Node&
+  emplace_back(Args&&... args) {
+    if (count == chunkStart(chunks.size())) {
+      chunks.push_back(std::allocator<Node>{}.allocate(chunkCapacity(chunks.size())));
+    }
+    auto* node = std::construct_at(&at(count), std::forward<Args>(args)...);
+    ++count;
+    return *node;
+  }
+
+  // Destroys every node but keeps the chunks, so that later nodes reuse them.
+  constexpr void
+  reset() {
+    for (size_t i = 0; i < count; ++i) {
+      std::destroy_at(&at(i));
+    }
+    count = 0;
+  }
+
+  constexpr void
+  clear() {
+    reset();
+    for (size_t chunk = 0; chunk < chunks.size(); ++chunk) {
+      std::allocator<Node>{}.deallocate(chunks[chunk], chunkCapacity(chunk));
+    }
+    chunks.clear();
+  }
+
+  template<class F>
+  constexpr void
+  forEach(F&& f) const {
+    for (size_t i = 0; i < count; ++i) {
+      f(static_cast<const Node&>(at(i)));
+    }
+  }
+
+private:
+  static constexpr size_t FIRST_CHUNK_SIZE = std::max<size_t>(1, 256 / sizeof(Node));
+
+  static constexpr size_t
+  chunkCapacity(size_t chunk) {
+    return FIRST_CHUNK_SIZE << chunk;
+  }
+
+  // The index of the first node in `chunk`.
+  static constexpr size_t
+  chunkStart(size_t chunk) {
+    return FIRST_CHUNK_SIZE * ((size_t{1} << chunk) - 1);
+  }
+
+  constexpr Node&
+  at(size_t index) const {
+    auto chunk = static_cast<size_t>(std::bit_width(index / FIRST_CHUNK_SIZE + 1)) - 1;
+    return chunks[chunk][index - chunkStart(chunk)];
+  }
+
+  std::vector<Node*> chunks;
+  size_t count = 0;
+};
+
+
+// A single contiguous block of nodes of mixed kinds, placed at offsets chosen
+// by whoever fills it. Packing the nodes of a tree in the order that passes
+// will visit them lets those passes stream through memory instead of hopping
+// between the separately grown stores for each kind of node.
+class PackedNodes {
+public:
+  constexpr PackedNodes() = default;
+
+  explicit PackedNodes(size_t bytes)
+    : storage{new std::byte[bytes]},
+      nodes{},
+      symbols{}
+      { }
+
+  PackedNodes(const PackedNodes&) = delete;
+  PackedNodes& operator=(const PackedNodes&) = delete;
+
+  constexpr PackedNodes(PackedNodes&& other) noexcept
+    : storage{std::exchange(other.storage, nullptr)},
+      nodes{std::move(other.nodes)},
+      symbols{std::move(other.symbols)}
+      { }
+
+  constexpr PackedNodes&
+  operator=(PackedNodes&& other) noexcept {
+    release();
+    storage = std::exchange(other.storage, nullptr);
+    nodes = std::move(other.nodes);
+    symbols = std::move(other.symbols);
+    return *this;
+  }
+
+  constexpr ~PackedNodes() { release(); }
+
+  // Constructs a node at `offset` bytes into the block. The offset must be
+  // suitably aligned for `Node`, and any operands must already be constructed.
+  template<class Node, class... Args>
+  const Node&
+  emplace(size_t offset, Args&&... args) {
+    static_assert(alignof(Node) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+    auto* node = new (storage + offset) Node(std::forward<Args>(args)...);
+    nodes.push_back(node);
+    if constexpr (!std::is_trivially_destructible_v<Node>) {
+      symbols.push_back(node);
+    }
+    return *node;
+  }
+
+  [[nodiscard]] constexpr const std::vector<const Expression*>&
+  getNodes() const {
+    return nodes;
+  }
+
+private:
+  constexpr void release();
+
+  // A plain pointer rather than a unique_ptr, which cannot yet be destroyed
+  // in a constant expression. Packed storage is only ever created at run
+  // time, but an empty block must still be destructible at compile time.
+  std::byte* storage = nullptr;
+  std::vector<const Expression*> nodes;
+  // Only symbols own resources, so they are the only nodes that must be
+  // destroyed explicitly.
+  std::vector<Symbol*> symbols;
+};
+
+
+// Combines several callables into one overload set, so that a visitor can be
+// written in place as `overloaded{[] (const Literal&) { ... }, ...}`.
+template<class... Handlers>
+struct overloaded : Handlers... {
+  using Handlers::operator()...;
+};
+
+template<class... Handlers>
+overloaded(Handlers...) -> overloaded<Handlers...>;
+
+
+// Calls `visitor` on `expression` as its concrete kind and returns whatever
+// that call returns. The visitor must accept a Literal, a Symbol, and an
+// Operation, and must return the same type for each.
+template<class Visitor>
+constexpr std::invoke_result_t<Visitor&&, const Literal&>
+visit(const Expression& expression, Visitor&& visitor) {
+  using Result = std::invoke_result_t<Visitor&&, const Literal&>;
+  static_assert(std::is_same_v<Result, std::invoke_result_t<Visitor&&, const Symbol&>>
+      && std::is_same_v<Result, std::invoke_result_t<Visitor&&, const Operation&>>,
+    "A visitor must return the same type for every kind of expression");
+
+  switch (expression.kind) {
+    case LITERAL:
+      return std::forward<Visitor>(visitor)(static_cast<const Literal&>(expression));
+    case SYMBOL:
+      return std::forward<Visitor>(visitor)(static_cast<const Symbol&>(expression));
+    case OPERATION:
+      break;
+  }
+  return std::forward<Visitor>(visitor)(static_cast<const Operation&>(expression));
+}
+
+
+// Like `ExprVisitor`, but each visit returns a result of type `R` directly,
+// such as the value of an expression or a count. Results flow back to the
+// caller in registers instead of through members or a side stack, so an
+// operation can simply visit its operands and combine what they return.
+template<class R>
+class TypedExprVisitor {
+public:
+  R
+  visit(const Expression& expression) {
+    return exprtree::visit(expression,
+      [this] (const auto& concrete) { return visitImpl(concrete); });
+  }
+
+  R visit(const Literal& literal)     { return visitImpl(literal); }
+  R visit(const Symbol& symbol)       { return visitImpl(symbol); }
+  R visit(const Operation& operation) { return visitImpl(operation); }
+
+private:
+  virtual R visitImpl(const Literal& literal) = 0;
+  virtual R visitImpl(const Symbol& symbol) = 0;
+  virtual R visitImpl(const Operation& operation) = 0;
+};
+
+
+inline void
+Expression::accept(ExprVisitor& visitor) const {
+  visit(*this, [&visitor] (const auto& expression) { visitor.visit(expression); });
+}
+
+
 class ExprTree {
 public:
-  ExprTree()
+  constexpr ExprTree()
     : operations{},
       literals{},
       symbols{},
+      packed{},
       root{nullptr}
       { }
 
+  // The nodes move along with the tree, so the tree moved from is left empty
+  // rather than with a root that it no longer owns.
+  constexpr ExprTree(ExprTree&& other) noexcept
+    : operations{std::move(other.operations)},
+      literals{std::move(other.literals)},
+      symbols{std::move(other.symbols)},
+      packed{std::move(other.packed)},
+      root{std::exchange(other.root, nullptr)}
+      { }
+
+  constexpr ExprTree&
+  operator=(ExprTree&& other) noexcept {
+    operations = std::move(other.operations);
+    literals = std::move(other.literals);
+    symbols = std::move(other.symbols);
+    packed = std::move(other.packed);
+    root = std::exchange(other.root, nullptr);
+    return *this;
+  }
+
   void
   accept(ExprVisitor& visitor) const {
     if (root) {
@@ -137,58 +451,312 @@ public:
   // The builder methods are unsafe in a few ways. Can you think about how
   // you would fix them to be safer?
 
-  [[nodiscard]] const Operation&
+  [[nodiscard]] constexpr const Operation&
   addOperation(OpCode opcode, const Expression& lhs, const Expression& rhs) {
-    operations.emplace_back(opcode, lhs, rhs);
-    return operations.back();
+    return operations.emplace_back(opcode, lhs, rhs);
   }
 
-  [[nodiscard]] const Literal&
+  [[nodiscard]] constexpr const Literal&
   addLiteral(int64_t value) {
-    literals.emplace_back(value);
-    return literals.back();
+    return literals.emplace_back(value);
   }
 
-  [[nodiscard]] const Symbol&
+  [[nodiscard]] constexpr const Symbol&
   addSymbol(std::string name) {
-    symbols.emplace_back(std::move(name));
-    return symbols.back();
+    // Some standard libraries cannot yet move a string parameter in a
+    // constant expression, so the name is copied when building at compile
+    // time.
+    if (std::is_constant_evaluated()) {
+      return symbols.emplace_back(std::string_view{name});
+    }
+    return symbols.emplace_back(std::move(name));
   }
 
-  void
+  constexpr void
   setRoot(const Expression& expr) {
     root = &expr;
   }
 
+  [[nodiscard]] constexpr const Expression*
+  getRoot() const {
+    return root;
+  }
+
+  // Calls `f` on every node that the tree owns, whether or not it is
+  // reachable from the root.
+  template<class F>
+  constexpr void
+  forEachNode(F&& f) const {
+    for (auto* node : packed.getNodes()) { f(*node); }
+    operations.forEach(f);
+    literals.forEach(f);
+    symbols.forEach(f);
+  }
+
+  // Replaces all of the nodes that the tree owns with `nodes`. Every node
+  // previously owned by the tree is destroyed, so `nodes` must not refer to
+  // them. See `relayout` in Relayout.h.
+  void
+  adopt(PackedNodes nodes, const Expression* newRoot) {
+    packed = std::move(nodes);
+    operations.clear();
+    literals.clear();
+    symbols.clear();
+    root = newRoot;
+  }
+
+  // Removes every node from the tree and leaves it without a root. The memory
+  // that held the nodes is kept, so building another tree of a similar size
+  // in its place does not allocate again.
+  constexpr void
+  clear() {
+    packed = PackedNodes{};
+    operations.reset();
+    literals.reset();
+    symbols.reset();
+    root = nullptr;
+  }
+
 private:
-  std::deque<Operation> operations;
-  std::deque<Literal> literals;
-  std::deque<Symbol> symbols;
+  NodeStore<Operation> operations;
+  NodeStore<Literal> literals;
+  NodeStore<Symbol> symbols;
+  PackedNodes packed;
   const Expression* root;
 };
 
 
+constexpr void
+PackedNodes::release() {
+  for (auto* symbol : symbols) {
+    std::destroy_at(symbol);
+  }
+  symbols.clear();
+  nodes.clear();
+  delete[] storage;
+  storage = nullptr;
+}
+
+
+// A visitor for performance critical passes. Dispatch selects the handler for
+// a node by its kind and calls `Derived::visitLiteral`, `visitSymbol`, or
+// `visitOperation` directly, so there are no virtual calls and the handlers
+// can be inlined into the dispatch. Handlers that a pass does not define do
+// nothing.
+//
+// `walk` visits every occurrence of every node reachable from the root of a
+// tree in depth first preorder, so a shared subexpression is visited once for
+// each place where it is used. Handlers that want the operands of an
+// operation visited without this can call `visit` on them instead.
+template<class Derived>
+class StaticExprVisitor {
+public:
+  constexpr decltype(auto)
+  visit(const Expression& expression) {
+    auto& self = static_cast<Derived&>(*this);
+    return exprtree::visit(expression, overloaded{
+      [&self] (const Literal& literal) -> decltype(auto) {
+        return self.visitLiteral(literal);
+      },
+      [&self] (const Symbol& symbol) -> decltype(auto) {
+        return self.visitSymbol(symbol);
+      },
+      [&self] (const Operation& operation) -> decltype(auto) {
+        return self.visitOperation(operation);
+      },
+    });
+  }
+
+  constexpr void
+  walk(const ExprTree& tree) {
+    std::vector<const Expression*> pending;
+    if (auto* root = tree.getRoot()) {
+      pending.push_back(root);
+    }
+    while (!pending.empty()) {
+      auto* expression = pending.back();
+      pending.pop_back();
+      if (pending.size() >= DEFAULT_PREFETCH_DISTANCE) {
+        prefetch(pending[pending.size() - DEFAULT_PREFETCH_DISTANCE]);
+      }
+      visit(*expression);
+      if (expression->kind == OPERATION) {
+        const auto& operation = static_cast<const Operation&>(*expression);
+        pending.push_back(&operation.rhs);
+        pending.push_back(&operation.lhs);
+      }
+    }
+  }
+
+  constexpr void visitLiteral(const Literal& /*literal*/) { }
+  constexpr void visitSymbol(const Symbol& /*symbol*/) { }
+  constexpr void visitOperation(const Operation& /*operation*/) { }
+};
+
+
+// Bindings are kept in an open addressing hash table with linear probing.
+// The hashes of the bindings sit in one flat array apart from the names and
+// values, so a probe usually reads a single cache line of hashes and then
+// only the binding that matches. Names may be given as any string_view, and
+// lookups that already know the hash of a name may pass it along. The table
+// can be used in constant expressions, so formulas with fixed bindings can be
+// evaluated at compile time.
 struct Environment {
 public:
-  void
-  set(const std::string& key, int64_t value) {
-    assignments[key] = value;
+  constexpr Environment() = default;
+
+  // Takes ownership of prepared bindings, moving their names into a table
+  // that is allocated once at its final size. A name that appears more than
+  // once keeps its last value.
+  constexpr explicit Environment(std::vector<std::pair<std::string, int64_t>> prepared) {
+    reserve(prepared.size());
+    for (auto& [name, value] : prepared) {
+      auto hash = hashName(name);
+      assign(std::move(name), hash, value);
+    }
   }
 
-  [[nodiscard]] std::optional<int64_t>
-  get(const std::string& key) const {
-    auto found = assignments.find(key);
-    if (found != assignments.end()) {
-      return {found->second};
-    } else {
+  constexpr void
+  set(std::string_view name, int64_t value) {
+    reserve(count + 1);
+    assign(name, hashName(name), value);
+  }
+
+  // Sets `names[i]` to `values[i]` for every i, after making room for all of
+  // them at once. The spans must be the same length.
+  constexpr void
+  setAll(std::span<const std::string_view> names, std::span<const int64_t> values) {
+    setEach(names, values);
+  }
+
+  constexpr void
+  setAll(std::span<const std::string> names, std::span<const int64_t> values) {
+    setEach(names, values);
+  }
+
+  // Makes room for `bindingCount` bindings in total, so that setting them
+  // does not grow the table again.
+  constexpr void
+  reserve(size_t bindingCount) {
+    if (bindingCount * 4 > hashes.size() * 3) {
+      rehash(std::max(MIN_CAPACITY, std::bit_ceil(bindingCount * 4 / 3 + 1)));
+    }
+  }
+
+  [[nodiscard]] constexpr std::optional<int64_t>
+  get(std::string_view name) const {
+    return get(name, hashName(name));
+  }
+
+  // Looks up `name`, whose hash from `hashName` is `hash`.
+  [[nodiscard]] constexpr std::optional<int64_t>
+  get(std::string_view name, uint64_t hash) const {
+    if (count == 0) {
+      return {};
+    }
+    auto slot = findSlot(name, asTag(hash));
+    if (hashes[slot] == EMPTY) {
       return {};
     }
+    return bindings[slot].value;
+  }
+
+  [[nodiscard]] constexpr size_t
+  size() const {
+    return count;
+  }
+
+  // Calls `f` with the name and value of every binding, in no particular
+  // order.
+  template<class F>
+  constexpr void
+  forEach(F&& f) const {
+    for (size_t slot = 0; slot < hashes.size(); ++slot) {
+      if (hashes[slot] != EMPTY) {
+        f(std::string_view{bindings[slot].name}, bindings[slot].value);
+      }
+    }
   }
 
 private:
-  std::unordered_map<std::string, uint64_t> assignments;
-};
+  struct Binding {
+    std::string name;
+    int64_t value = 0;
+  };
+
+  // A slot whose hash is EMPTY holds no binding, so names that hash to EMPTY
+  // are stored under a different tag.
+  static constexpr uint64_t EMPTY = 0;
+  static constexpr size_t MIN_CAPACITY = 8;
+
+  static constexpr uint64_t
+  asTag(uint64_t hash) {
+    return hash == EMPTY ? 1 : hash;
+  }
 
+  // Returns the slot holding `name`, or the empty slot where it belongs. The
+  // table always has at least one empty slot, so the probe ends.
+  constexpr size_t
+  findSlot(std::string_view name, uint64_t tag) const {
+    auto mask = hashes.size() - 1;
+    auto slot = static_cast<size_t>(tag) & mask;
+    while (hashes[slot] != EMPTY
+           && (hashes[slot] != tag || bindings[slot].name != name)) {
+      slot = (slot + 1) & mask;
+    }
+    return slot;
+  }
+
+  template<class Name>
+  constexpr void
+  assign(Name&& name, uint64_t hash, int64_t value) {
+    auto tag = asTag(hash);
+    auto slot = findSlot(name, tag);
+    if (hashes[slot] == EMPTY) {
+      hashes[slot] = tag;
+      bindings[slot].name = std::string{std::forward<Name>(name)};
+      ++count;
+    }
+    bindings[slot].value = value;
+  }
+
+  template<class Name>
+  constexpr void
+  setEach(std::span<const Name> names, std::span<const int64_t> values) {
+    assert(names.size() == values.size());
+    reserve(count + names.size());
+    for (size_t i = 0; i < names.size(); ++i) {
+      assign(std::string_view{names[i]}, hashName(names[i]), values[i]);
+    }
+  }
+
+  // Moves every binding into a table with `capacity` slots, which must be a
+  // power of two larger than the number of bindings.
+  constexpr void
+  rehash(size_t capacity) {
+    auto oldHashes = std::move(hashes);
+    auto oldBindings = std::move(bindings);
+    hashes.assign(capacity, EMPTY);
+    bindings.clear();
+    bindings.resize(capacity);
+    auto mask = capacity - 1;
+    for (size_t i = 0; i < oldHashes.size(); ++i) {
+      if (oldHashes[i] != EMPTY) {
+        // Every name is already distinct, so each only needs an empty slot.
+        auto slot = static_cast<size_t>(oldHashes[i]) & mask;
+        while (hashes[slot] != EMPTY) {
+          slot = (slot + 1) & mask;
+        }
+        hashes[slot] = oldHashes[i];
+        bindings[slot] = std::move(oldBindings[i]);
+      }
+    }
+  }
+
+  std::vector<uint64_t> hashes;
+  std::vector<Binding> bindings;
+  size_t count = 0;
+};
 
 }
 
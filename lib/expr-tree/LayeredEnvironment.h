@@ -0,0 +1,194 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "ExprTree.h"
+
+namespace exprtree {
+
+
+namespace detail {
+
+
+// Every binding visible through a layer, collected on first use. Copying a
+// layer does not copy its collected bindings, since the copy may be changed.
+class CollapsedLayers {
+public:
+  CollapsedLayers() = default;
+
+  CollapsedLayers(const CollapsedLayers& /*other*/)
+    : CollapsedLayers{}
+    { }
+
+  CollapsedLayers&
+  operator=(const CollapsedLayers& /*other*/) {
+    reset();
+    return *this;
+  }
+
+  ~CollapsedLayers() { reset(); }
+
+  // Returns the collected bindings, calling `collect` for them if there are
+  // none yet. Threads that race to collect them each call `collect`, and all
+  // but the first to finish throw their result away, so no thread waits for
+  // another.
+  template<class F>
+  const Environment&
+  get(F&& collect) const {
+    const auto* bindings = collapsed.load(std::memory_order_acquire);
+    if (!bindings) {
+      const auto* collected = new Environment{std::forward<F>(collect)()};
+      if (collapsed.compare_exchange_strong(bindings, collected, std::memory_order_acq_rel,
+                                            std::memory_order_acquire)) {
+        bindings = collected;
+      } else {
+        delete collected;
+      }
+    }
+    return *bindings;
+  }
+
+  void
+  reset() {
+    delete collapsed.exchange(nullptr, std::memory_order_acq_rel);
+  }
+
+private:
+  mutable std::atomic<const Environment*> collapsed = nullptr;
+};
+
+
+}
+
+
+// A `LayeredEnvironment` holds only the bindings that differ from those of a
+// shared parent, which holds only the bindings that differ from its own
+// parent, and so on. Many variants of one large environment can then be made
+// at a cost proportional to the number of bindings each changes, rather than
+// by copying every binding. Copying a layer likewise copies only its own
+// bindings and shares its parent.
+//
+//   auto base = std::make_shared<const LayeredEnvironment>(std::move(bindings));
+//   LayeredEnvironment variant{base};
+//   variant.set("rate", 7);
+//
+// Looking a name up checks the layer itself and then each parent in turn, so
+// it costs a probe per layer. Past `MAX_WALKED_LAYERS`, the parent instead
+// collects every binding visible through it into a cache the first time a
+// child looks a name up through it, and answers from the cache from then on,
+// so that lookups in deep chains take two probes. Parents never change, so
+// the cache never goes stale, and since it is shared by every child of the
+// parent, it is built once for all of them rather than once per variant.
+//
+// The cache is published with a single atomic pointer, so any layer, shared
+// or not, may be read from many threads at once as long as none of them sets
+// bindings in it.
+class LayeredEnvironment {
+public:
+  // Chains of up to this many layers are looked up by checking each layer.
+  static constexpr size_t MAX_WALKED_LAYERS = 4;
+
+  LayeredEnvironment() = default;
+
+  // A layer without a parent that holds `bindings`.
+  explicit LayeredEnvironment(Environment bindings)
+    : overrides{std::move(bindings)},
+      parent{},
+      depth{1},
+      cache{}
+      { }
+
+  // A layer that holds no bindings of its own yet and inherits from `parent`.
+  // The parent must not be modified afterward.
+  explicit LayeredEnvironment(std::shared_ptr<const LayeredEnvironment> parent)
+    : overrides{},
+      parent{std::move(parent)},
+      depth{this->parent ? this->parent->depth + 1 : 1},
+      cache{}
+      { }
+
+  // Binds `name` in this layer only, hiding any binding in the parents.
+  void
+  set(std::string_view name, int64_t value) {
+    overrides.set(name, value);
+    cache.reset();
+  }
+
+  [[nodiscard]] std::optional<int64_t>
+  get(std::string_view name) const {
+    return get(name, hashName(name));
+  }
+
+  [[nodiscard]] std::optional<int64_t>
+  get(std::string_view name, uint64_t hash) const {
+    if (auto value = overrides.get(name, hash)) {
+      return value;
+    }
+    return parent ? parent->getShared(name, hash) : std::nullopt;
+  }
+
+  // Returns every binding visible through this layer, as a plain Environment
+  // owned by the caller. This copies every binding, so it is for handing a
+  // chain to code that needs an Environment, not for faster lookups.
+  [[nodiscard]] Environment
+  flatten() const {
+    std::vector<const LayeredEnvironment*> layers;
+    size_t bindingCount = 0;
+    for (const auto* layer = this; layer; layer = layer->parent.get()) {
+      layers.push_back(layer);
+      bindingCount += layer->overrides.size();
+    }
+    // Outer layers are applied first, so that inner layers override them.
+    Environment flat;
+    flat.reserve(bindingCount);
+    for (auto layer = layers.rbegin(); layer != layers.rend(); ++layer) {
+      (*layer)->overrides.forEach([&flat] (std::string_view name, int64_t value) {
+        flat.set(name, value);
+      });
+    }
+    return flat;
+  }
+
+  // The number of bindings held by this layer itself.
+  [[nodiscard]] size_t
+  size() const {
+    return overrides.size();
+  }
+
+  [[nodiscard]] const std::shared_ptr<const LayeredEnvironment>&
+  getParent() const {
+    return parent;
+  }
+
+private:
+  // Looks a name up on behalf of a child, through the cache once this layer
+  // heads a deep chain.
+  [[nodiscard]] std::optional<int64_t>
+  getShared(std::string_view name, uint64_t hash) const {
+    if (depth > MAX_WALKED_LAYERS) {
+      return cache.get([this] { return flatten(); }).get(name, hash);
+    }
+    for (const auto* layer = this; layer; layer = layer->parent.get()) {
+      if (auto value = layer->overrides.get(name, hash)) {
+        return value;
+      }
+    }
+    return {};
+  }
+
+  Environment overrides;
+  std::shared_ptr<const LayeredEnvironment> parent;
+  // The number of layers in the chain that ends with this one.
+  size_t depth = 1;
+  detail::CollapsedLayers cache;
+};
+
+
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+
+namespace exprtree {
+
+
+// Walkers that keep an explicit stack of pending nodes know which nodes they
+// will reach next long before they reach them. Prefetching the node a few
+// entries below the top of the stack hides some of the latency of reaching
+// nodes that are scattered through memory. The distance is how many entries
+// ahead of the next node to prefetch; a distance of zero disables it.
+inline constexpr size_t DEFAULT_PREFETCH_DISTANCE = 2;
+
+
+constexpr void
+prefetch(const void* address) {
+  if (std::is_constant_evaluated()) {
+    return;
+  }
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_prefetch(address, 0, 3);
+#else
+  (void)address;
+#endif
+}
+
+
+}
@@ -0,0 +1,329 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "ExprTree.h"
+
+namespace exprtree {
+
+
+// The order in which `relayout` places nodes in memory.
+//
+//   PREORDER        nodes appear in the order that a depth first walk from the
+//                   root reaches them, so each left operand directly follows
+//                   its operation
+//   VAN_EMDE_BOAS   the tree is split at half its height into a top tree and
+//                   the bottom trees hanging from it, each of which is placed
+//                   contiguously and split the same way in turn, so that any
+//                   path from the root crosses few cache lines regardless of
+//                   cache line size
+enum Layout : uint8_t {
+  PREORDER,
+  VAN_EMDE_BOAS
+};
+
+
+// Maps the nodes that a tree held before `relayout` to their new copies.
+class NodeRemapping {
+public:
+  explicit NodeRemapping(std::vector<std::pair<const Expression*, const Expression*>> moves)
+    : moves{std::move(moves)} {
+    std::sort(this->moves.begin(), this->moves.end(), std::less<>{});
+  }
+
+  // Returns the copy of `old`, or nullptr if it was not relaid out.
+  [[nodiscard]] const Expression*
+  find(const Expression& old) const {
+    auto found = std::lower_bound(moves.begin(), moves.end(), &old,
+      [] (const auto& move, const Expression* key) {
+        return std::less<>{}(move.first, key);
+      });
+    return found != moves.end() && found->first == &old ? found->second : nullptr;
+  }
+
+  // Returns the copy of `old`, which must have been relaid out.
+  [[nodiscard]] const Expression&
+  operator()(const Expression& old) const {
+    return *find(old);
+  }
+
+  [[nodiscard]] size_t
+  size() const {
+    return moves.size();
+  }
+
+private:
+  std::vector<std::pair<const Expression*, const Expression*>> moves;
+};
+
+
+struct RelayoutResult {
+  const Expression* root;
+  NodeRemapping remapping;
+};
+
+
+namespace detail {
+
+// The facts about a node that relayout needs.
+struct NodeShape {
+  explicit NodeShape(const Expression& node)
+    : operation{node.kind == OPERATION ? static_cast<const Operation*>(&node) : nullptr},
+      size{visit(node, [] (const auto& concrete) { return sizeof(concrete); })},
+      alignment{visit(node, [] (const auto& concrete) { return alignof(decltype(concrete)); })}
+      { }
+
+  const Operation* operation;
+  size_t size;
+  size_t alignment;
+};
+
+
+// Numbers the nodes of a tree in preorder, first those reachable from the
+// root and then any others the tree owns. The number of each node is kept in
+// its epoch mark as an offset from a block of fresh epochs, so finding the
+// number of an operand needs no lookup table, and marks from the block never
+// match an epoch that a later pass draws.
+class NodeNumbering {
+public:
+  explicit NodeNumbering(const ExprTree& tree) {
+    auto reached = newEpoch();
+    std::vector<const Expression*> pending;
+    auto walkFrom = [this, reached, &pending] (const Expression& start) {
+      pending.push_back(&start);
+      while (!pending.empty()) {
+        auto* node = pending.back();
+        pending.pop_back();
+        if (node->epoch == reached) {
+          continue;
+        }
+        node->epoch = reached;
+        nodes.push_back(node);
+        if (auto* operation = NodeShape{*node}.operation) {
+          pending.push_back(&operation->rhs);
+          pending.push_back(&operation->lhs);
+        }
+      }
+    };
+    if (auto* root = tree.getRoot()) {
+      walkFrom(*root);
+    }
+    tree.forEachNode(walkFrom);
+
+    first = newEpochs(nodes.size());
+    for (size_t i = 0; i < nodes.size(); ++i) {
+      nodes[i]->epoch = first + i;
+    }
+  }
+
+  [[nodiscard]] size_t
+  numberOf(const Expression& node) const {
+    return static_cast<size_t>(node.epoch - first);
+  }
+
+  // The nodes in order of their numbers.
+  std::vector<const Expression*> nodes;
+
+private:
+  uint64_t first = 0;
+};
+
+
+// Constructs a copy of `node` at `offset` in packed storage, with operands
+// redirected to their own copies, which are indexed by node number.
+inline const Expression*
+copyNode(const Expression& node, PackedNodes& packed, size_t offset,
+         const NodeNumbering& numbering, const std::vector<const Expression*>& copies) {
+  return visit(node, overloaded{
+    [&] (const Literal& literal) -> const Expression* {
+      return &packed.emplace<Literal>(offset, literal.value);
+    },
+    [&] (const Symbol& symbol) -> const Expression* {
+      return &packed.emplace<Symbol>(offset, symbol.name);
+    },
+    [&] (const Operation& operation) -> const Expression* {
+      return &packed.emplace<Operation>(offset, operation.opCode,
+        *copies[numbering.numberOf(operation.lhs)], *copies[numbering.numberOf(operation.rhs)]);
+    },
+  });
+}
+
+
+// Decides the van Emde Boas order of the nodes reachable from the root, as a
+// list of node numbers. Each node is placed once, the first time the layout
+// reaches it.
+class VanEmdeBoasOrder {
+public:
+  explicit VanEmdeBoasOrder(const NodeNumbering& numbering)
+    : numbering{numbering},
+      heights(numbering.nodes.size(), 0),
+      placed(numbering.nodes.size(), false)
+      { }
+
+  std::vector<size_t> order;
+
+  void
+  add(const Expression& start) {
+    std::vector<const Expression*> bottom;
+    add(start, heightOf(start), bottom);
+  }
+
+  [[nodiscard]] bool
+  contains(size_t number) const {
+    return placed[number];
+  }
+
+private:
+  // Places the top `levels` levels below `top` and collects the unplaced
+  // nodes just beneath them, from left to right, in `bottom`. The recursion
+  // only deepens as the number of levels halves, so it stays shallow even for
+  // degenerate trees.
+  void
+  add(const Expression& top, size_t levels, std::vector<const Expression*>& bottom) {
+    auto number = numbering.numberOf(top);
+    if (placed[number]) {
+      return;
+    }
+    if (levels <= 1) {
+      placed[number] = true;
+      order.push_back(number);
+      if (auto* operation = NodeShape{top}.operation) {
+        bottom.push_back(&operation->lhs);
+        bottom.push_back(&operation->rhs);
+      }
+      return;
+    }
+
+    auto topLevels = levels / 2;
+    std::vector<const Expression*> middle;
+    add(top, topLevels, middle);
+    for (auto* subtree : middle) {
+      add(*subtree, levels - topLevels, bottom);
+    }
+  }
+
+  // The number of levels in the tree below `start`, computed with an
+  // explicit stack.
+  size_t
+  heightOf(const Expression& start) {
+    struct Step {
+      const Expression* node;
+      bool combining;
+    };
+    std::vector<Step> work{{&start, false}};
+    while (!work.empty()) {
+      auto [node, combining] = work.back();
+      work.pop_back();
+      auto& height = heights[numbering.numberOf(*node)];
+      auto* operation = NodeShape{*node}.operation;
+      if (combining) {
+        height = 1 + std::max(heights[numbering.numberOf(operation->lhs)],
+                              heights[numbering.numberOf(operation->rhs)]);
+      } else if (height == 0) {
+        height = 1;
+        if (operation) {
+          work.push_back({node, true});
+          work.push_back({&operation->rhs, false});
+          work.push_back({&operation->lhs, false});
+        }
+      }
+    }
+    return heights[numbering.numberOf(start)];
+  }
+
+  const NodeNumbering& numbering;
+  std::vector<size_t> heights;
+  std::vector<bool> placed;
+};
+
+}
+
+
+// Rewrites the storage of `tree` so that its nodes sit in one contiguous block
+// in the given layout, letting passes like `evaluate` and `traverse` stream
+// through memory. Nodes reachable from the root come first, followed by any
+// other nodes the tree owns. Shared subexpressions remain shared.
+//
+// Every node previously owned by the tree is destroyed, so existing handles
+// must be translated through the returned remapping. The tree's root is
+// updated and also returned. Nodes that are added afterward are stored as
+// usual until the next relayout.
+inline RelayoutResult
+relayout(ExprTree& tree, Layout layout = PREORDER) {
+  detail::NodeNumbering numbering{tree};
+  const auto& nodes = numbering.nodes;
+
+  // Node numbers are already in preorder, so only van Emde Boas order needs
+  // working out. Nodes that the root cannot reach follow in preorder either
+  // way.
+  std::vector<size_t> order;
+  if (layout == VAN_EMDE_BOAS && tree.getRoot()) {
+    detail::VanEmdeBoasOrder vanEmdeBoas{numbering};
+    vanEmdeBoas.add(*tree.getRoot());
+    order = std::move(vanEmdeBoas.order);
+    for (size_t number = 0; number < nodes.size(); ++number) {
+      if (!vanEmdeBoas.contains(number)) {
+        order.push_back(number);
+      }
+    }
+  } else {
+    order.resize(nodes.size());
+    for (size_t number = 0; number < nodes.size(); ++number) {
+      order[number] = number;
+    }
+  }
+
+  std::vector<size_t> offsets(nodes.size());
+  size_t end = 0;
+  for (auto number : order) {
+    detail::NodeShape shape{*nodes[number]};
+    auto offset = (end + shape.alignment - 1) / shape.alignment * shape.alignment;
+    offsets[number] = offset;
+    end = offset + shape.size;
+  }
+
+  // Operands must be constructed before the operations that refer to them,
+  // so nodes are built in postorder even though they are placed in `order`.
+  PackedNodes packed{end};
+  std::vector<const Expression*> copies(nodes.size(), nullptr);
+  struct Step {
+    const Expression* node;
+    bool combining;
+  };
+  std::vector<Step> work;
+  for (auto* start : nodes) {
+    work.push_back({start, false});
+    while (!work.empty()) {
+      auto [node, combining] = work.back();
+      work.pop_back();
+      auto number = numbering.numberOf(*node);
+      if (copies[number]) {
+        continue;
+      }
+      auto* operation = detail::NodeShape{*node}.operation;
+      if (operation && !combining) {
+        work.push_back({node, true});
+        work.push_back({&operation->rhs, false});
+        work.push_back({&operation->lhs, false});
+        continue;
+      }
+      copies[number] = detail::copyNode(*node, packed, offsets[number], numbering, copies);
+    }
+  }
+
+  std::vector<std::pair<const Expression*, const Expression*>> moves;
+  moves.reserve(nodes.size());
+  for (size_t number = 0; number < nodes.size(); ++number) {
+    moves.emplace_back(nodes[number], copies[number]);
+  }
+  const Expression* newRoot = tree.getRoot() ? copies[numbering.numberOf(*tree.getRoot())] : nullptr;
+  tree.adopt(std::move(packed), newRoot);
+  return {newRoot, NodeRemapping{std::move(moves)}};
+}
+
+}
@@ -0,0 +1,284 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "ExprTree.h"
+
+namespace exprtree {
+
+
+// One published version of the bindings of a `VersionedEnvironment`. A
+// version is only ever shared as const, so it never changes once it has been
+// published.
+struct EnvironmentVersion {
+  [[nodiscard]] std::optional<int64_t>
+  get(std::string_view name) const {
+    return bindings.get(name);
+  }
+
+  [[nodiscard]] std::optional<int64_t>
+  get(std::string_view name, uint64_t hash) const {
+    return bindings.get(name, hash);
+  }
+
+  Environment bindings;
+  // Versions are numbered from 0 in the order they were published.
+  uint64_t number;
+};
+
+
+namespace detail {
+
+
+// A reader slot holds 0 while it is free, and otherwise the epoch in which
+// its reader started reading. Each slot has a cache line of its own, so that
+// readers in different slots never write to the same line.
+struct alignas(64) ReaderSlot {
+  std::atomic<uint64_t> epoch{0};
+};
+
+
+struct ReaderSlotBlock {
+  static constexpr size_t SIZE = 32;
+
+  std::array<ReaderSlot, SIZE> slots;
+  ReaderSlotBlock* next = nullptr;
+};
+
+
+// The slot each thread tries first. Starting from the thread id spreads
+// threads over the slots, and remembering the slot last taken keeps a thread
+// on it from then on.
+inline thread_local size_t readerSlotHint = std::hash<std::thread::id>{}(std::this_thread::get_id());
+
+
+}
+
+
+// A version of a `VersionedEnvironment` that stays valid and unchanged for as
+// long as the snapshot is held. A snapshot must not outlive its environment.
+class EnvironmentSnapshot {
+public:
+  EnvironmentSnapshot(const EnvironmentSnapshot&) = delete;
+  EnvironmentSnapshot& operator=(const EnvironmentSnapshot&) = delete;
+
+  EnvironmentSnapshot(EnvironmentSnapshot&& other) noexcept
+    : slot{std::exchange(other.slot, nullptr)},
+      version{std::exchange(other.version, nullptr)}
+      { }
+
+  EnvironmentSnapshot&
+  operator=(EnvironmentSnapshot&& other) noexcept {
+    release();
+    slot = std::exchange(other.slot, nullptr);
+    version = std::exchange(other.version, nullptr);
+    return *this;
+  }
+
+  ~EnvironmentSnapshot() { release(); }
+
+  [[nodiscard]] const EnvironmentVersion&
+  operator*() const {
+    return *version;
+  }
+
+  [[nodiscard]] const EnvironmentVersion*
+  operator->() const {
+    return version;
+  }
+
+private:
+  friend class VersionedEnvironment;
+
+  EnvironmentSnapshot(detail::ReaderSlot* slot, const EnvironmentVersion* version)
+    : slot{slot},
+      version{version}
+      { }
+
+  void
+  release() {
+    if (slot) {
+      slot->epoch.store(0, std::memory_order_release);
+    }
+  }
+
+  detail::ReaderSlot* slot;
+  const EnvironmentVersion* version;
+};
+
+
+// Bindings that are read by many threads while others change them, in the
+// style of read-copy-update. Writers never modify the bindings that readers
+// see. Instead, each change copies the current version, applies the change to
+// the copy, and publishes the copy by swapping a single pointer. Readers take
+// a snapshot of whichever version is current and may evaluate against it for
+// as long as they hold the snapshot.
+//
+//   auto snapshot = environment.snapshot();
+//   evaluate(tree, *snapshot);
+//
+// Old versions are freed with epoch-based reclamation. Taking a snapshot
+// claims a free reader slot, records the current epoch in it, and then loads
+// the current version; the snapshot gives the slot back when it is
+// destroyed. Each publication retires the version it replaces with the epoch
+// at that moment and advances the epoch, and a retired version is freed
+// once every claimed slot holds a later epoch, since any reader that could
+// still see it started no later than it was retired. Readers thus never
+// wait and never write to memory shared with other readers, as long as
+// there are free slots on their own cache lines; when every slot is taken a
+// reader adds a block of new slots. In exchange, a reader that holds a
+// snapshot for a long time keeps every version retired since it started
+// from being freed.
+//
+// Writers do wait for one another, so that concurrent changes are applied one
+// after another and none is lost. Because each change copies every binding,
+// changes to many bindings at once should be grouped with `update`.
+class VersionedEnvironment {
+public:
+  VersionedEnvironment()
+    : VersionedEnvironment{Environment{}}
+    { }
+
+  explicit VersionedEnvironment(Environment initial)
+    : current{new EnvironmentVersion{std::move(initial), 0}},
+      epoch{1},
+      slotBlocks{new detail::ReaderSlotBlock{}},
+      writerMutex{},
+      retired{}
+      { }
+
+  VersionedEnvironment(const VersionedEnvironment&) = delete;
+  VersionedEnvironment& operator=(const VersionedEnvironment&) = delete;
+
+  ~VersionedEnvironment() {
+    delete current.load(std::memory_order_relaxed);
+    for (const auto& version : retired) {
+      delete version.version;
+    }
+    auto* block = slotBlocks.load(std::memory_order_relaxed);
+    while (block) {
+      delete std::exchange(block, block->next);
+    }
+  }
+
+  // The version must be loaded after the slot is claimed, and the writer
+  // advances the epoch after replacing the version, so a reader whose slot
+  // holds an epoch later than that of a retired version cannot have loaded
+  // it. Every step is sequentially consistent to keep that order.
+  [[nodiscard]] EnvironmentSnapshot
+  snapshot() const {
+    auto* slot = claimSlot(epoch.load());
+    return EnvironmentSnapshot{slot, current.load()};
+  }
+
+  void
+  set(std::string_view name, int64_t value) {
+    update([name, value] (Environment& bindings) { bindings.set(name, value); });
+  }
+
+  // Calls `change` on a copy of the current bindings and publishes the
+  // result as a single new version.
+  template<class F>
+  void
+  update(F&& change) {
+    std::lock_guard lock{writerMutex};
+    // Only writers free versions, so the current one stays valid here.
+    const auto* previous = current.load(std::memory_order_relaxed);
+    Environment bindings = previous->bindings;
+    std::forward<F>(change)(bindings);
+    publishLocked(std::move(bindings), previous->number + 1);
+  }
+
+  // Replaces every binding with `bindings` as a new version.
+  void
+  publish(Environment bindings) {
+    std::lock_guard lock{writerMutex};
+    auto number = current.load(std::memory_order_relaxed)->number + 1;
+    publishLocked(std::move(bindings), number);
+  }
+
+private:
+  struct RetiredVersion {
+    const EnvironmentVersion* version;
+    uint64_t epoch;
+  };
+
+  detail::ReaderSlot*
+  claimSlot(uint64_t readEpoch) const {
+    auto& hint = detail::readerSlotHint;
+    auto* head = slotBlocks.load();
+    size_t blockIndex = 0;
+    for (auto* block = head; block; block = block->next, ++blockIndex) {
+      for (size_t i = 0; i < detail::ReaderSlotBlock::SIZE; ++i) {
+        auto index = (hint + i) % detail::ReaderSlotBlock::SIZE;
+        auto& slot = block->slots[index];
+        uint64_t free = 0;
+        if (slot.epoch.load(std::memory_order_relaxed) == 0
+            && slot.epoch.compare_exchange_strong(free, readEpoch)) {
+          hint = index;
+          return &slot;
+        }
+      }
+    }
+
+    // Every slot is taken, so this reader adds a block with its slot already
+    // claimed. A writer that does not find the block yet cannot retire any
+    // version this reader sees, since the reader loads the version only after
+    // the block is added.
+    auto* block = new detail::ReaderSlotBlock{};
+    block->slots[0].epoch.store(readEpoch, std::memory_order_relaxed);
+    block->next = head;
+    while (!slotBlocks.compare_exchange_weak(block->next, block)) { }
+    hint = 0;
+    return &block->slots[0];
+  }
+
+  void
+  publishLocked(Environment bindings, uint64_t number) {
+    auto* previous = current.exchange(new EnvironmentVersion{std::move(bindings), number});
+    retired.push_back({previous, epoch.fetch_add(1)});
+    reclaimLocked();
+  }
+
+  // Frees every retired version that no reader can still see.
+  void
+  reclaimLocked() {
+    auto oldestReader = std::numeric_limits<uint64_t>::max();
+    for (auto* block = slotBlocks.load(); block; block = block->next) {
+      for (const auto& slot : block->slots) {
+        auto readEpoch = slot.epoch.load();
+        if (readEpoch != 0) {
+          oldestReader = std::min(oldestReader, readEpoch);
+        }
+      }
+    }
+    std::erase_if(retired, [oldestReader] (const RetiredVersion& version) {
+      if (version.epoch >= oldestReader) {
+        return false;
+      }
+      delete version.version;
+      return true;
+    });
+  }
+
+  std::atomic<const EnvironmentVersion*> current;
+  std::atomic<uint64_t> epoch;
+  mutable std::atomic<detail::ReaderSlotBlock*> slotBlocks;
+  std::mutex writerMutex;
+  std::vector<RetiredVersion> retired;
+};
+
+
+}
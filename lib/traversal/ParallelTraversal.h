@@ -0,0 +1,288 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+#include "Traversal.h"
+#include "WorkStealingPool.h"
+
+namespace traversal {
+
+
+// How much a parallel traversal promises about the order of its callbacks.
+//
+//   UNORDERED     subtrees near the root are all fanned out as separate tasks,
+//                 so callbacks for any two nodes may run in any order
+//   PER_SUBTREE   nodes above `spawnDepth` are reported by the calling thread
+//                 in depth first order, and every subtree rooted at
+//                 `spawnDepth`, its root included, is reported by a single
+//                 task in depth first order, exactly as `traverse` would
+//                 report it
+//
+// In either case, callbacks for different subtrees run concurrently.
+enum Ordering : uint8_t {
+  UNORDERED,
+  PER_SUBTREE
+};
+
+
+struct ParallelOptions {
+  Ordering ordering = UNORDERED;
+  // The depth below which subtrees are walked sequentially within one task.
+  size_t spawnDepth = 8;
+};
+
+
+namespace detail {
+
+// Tracks visits for many tasks at once. Each node is claimed by exactly one
+// task, the first to reach it.
+template<Graph GraphKind, class Visits,
+         bool = GraphTraits<GraphKind>::mayShare>
+class ConcurrentVisitTracker {
+public:
+  using NodeRef = typename GraphTraits<GraphKind>::NodeRef;
+
+  explicit ConcurrentVisitTracker(GraphKind& /*graph*/) { }
+
+  bool claim(NodeRef /*node*/) { return true; }
+};
+
+
+// Claims are spread over independently locked shards to limit contention.
+template<class GraphKind>
+class ConcurrentVisitTracker<GraphKind, HashedVisits, true> {
+public:
+  using NodeRef = typename GraphTraits<GraphKind>::NodeRef;
+
+  explicit ConcurrentVisitTracker(GraphKind& /*graph*/)
+    : shards{}
+      { }
+
+  bool
+  claim(NodeRef node) {
+    auto& shard = shards[std::hash<NodeRef>{}(node) % shards.size()];
+    std::lock_guard lock{shard.mutex};
+    return shard.nodes.insert(node).second;
+  }
+
+private:
+  struct Shard {
+    std::mutex mutex;
+    std::unordered_set<NodeRef> nodes;
+  };
+
+  std::array<Shard, 64> shards;
+};
+
+
+// Stamping a node is a single atomic exchange, so claims never take a lock.
+template<class GraphKind>
+class ConcurrentVisitTracker<GraphKind, EpochVisits, true> {
+  static_assert(EpochMarkedGraph<GraphKind>,
+    "EpochVisits requires a graph that provides epoch marks");
+
+public:
+  using Traits = GraphTraits<GraphKind>;
+  using NodeRef = typename Traits::NodeRef;
+
+  explicit ConcurrentVisitTracker(GraphKind& graph)
+    : graph{graph},
+      epoch{Traits::newEpoch()}
+      { }
+
+  bool
+  claim(NodeRef node) {
+    std::atomic_ref mark{Traits::epochOf(graph, node)};
+    return mark.exchange(epoch, std::memory_order_relaxed) != epoch;
+  }
+
+private:
+  GraphKind& graph;
+  const uint64_t epoch;
+};
+
+
+template<class GraphKind, class Visits, class OnNode, class OnEdge>
+class ParallelWalk {
+public:
+  using Traits = GraphTraits<GraphKind>;
+  using NodeRef = typename Traits::NodeRef;
+
+  ParallelWalk(GraphKind& graph, OnNode& onNode, OnEdge& onEdge,
+               TaskGroup& group, ParallelOptions options)
+    : graph{graph},
+      onNode{onNode},
+      onEdge{onEdge},
+      group{group},
+      options{options},
+      visits{graph},
+      stopped{false}
+      { }
+
+  void
+  run() {
+    auto entry = Traits::entry(graph);
+    if (!entry) {
+      return;
+    }
+    if (entersInTask(0)) {
+      spawnSubtree(*entry, 0);
+    } else if (!enter(*entry)) {
+      return;
+    } else if (shouldSpawn(0)) {
+      spawnExpansion(*entry, 0);
+    } else {
+      expand(*entry, 0);
+    }
+  }
+
+private:
+  struct Edge {
+    NodeRef predecessor;
+    NodeRef target;
+    size_t depth;
+  };
+
+  // Whether the successors of a node already entered at `depth` are handed
+  // off to a task of their own.
+  bool
+  shouldSpawn(size_t depth) const {
+    return options.ordering == UNORDERED && depth < options.spawnDepth;
+  }
+
+  // Whether a node reached at `depth` is entered by a task of its own, so
+  // that the task reports its whole subtree.
+  bool
+  entersInTask(size_t depth) const {
+    return options.ordering == PER_SUBTREE && depth == options.spawnDepth;
+  }
+
+  void
+  spawnExpansion(NodeRef node, size_t depth) {
+    group.spawn([this, node, depth] { expand(node, depth); });
+  }
+
+  void
+  spawnSubtree(NodeRef node, size_t depth) {
+    group.spawn([this, node, depth] {
+      if (!stopped.load(std::memory_order_relaxed) && enter(node)) {
+        expand(node, depth);
+      }
+    });
+  }
+
+  // Claims and reports `node`, returning whether its successors should be
+  // followed.
+  bool
+  enter(NodeRef node) {
+    if (!claim(node)) {
+      return false;
+    }
+    auto control = invokeWithControl(onNode, node);
+    if (control == STOP) {
+      stopped.store(true, std::memory_order_relaxed);
+      return false;
+    }
+    return control != SKIP && Traits::successorCount(graph, node) != 0;
+  }
+
+  // Follows everything reachable from `node`, which has already been entered
+  // at `depth`. Nodes that should be walked by a task of their own are handed
+  // off to the pool, and all others are walked depth first right here.
+  void
+  expand(NodeRef node, size_t depth) {
+    std::vector<Edge> pending;
+    pushSuccessors(pending, node, depth);
+
+    while (!pending.empty() && !stopped.load(std::memory_order_relaxed)) {
+      auto [predecessor, target, targetDepth] = pending.back();
+      pending.pop_back();
+      prefetchAhead(pending);
+
+      auto control = invokeWithControl(onEdge, predecessor, target);
+      if (control == STOP) {
+        stopped.store(true, std::memory_order_relaxed);
+        return;
+      } else if (control == SKIP) {
+        continue;
+      }
+
+      if (entersInTask(targetDepth)) {
+        spawnSubtree(target, targetDepth);
+      } else if (!enter(target)) {
+        continue;
+      } else if (shouldSpawn(targetDepth)) {
+        spawnExpansion(target, targetDepth);
+      } else {
+        pushSuccessors(pending, target, targetDepth);
+      }
+    }
+  }
+
+  void
+  prefetchAhead(const std::vector<Edge>& pending) const {
+    constexpr auto distance = exprtree::DEFAULT_PREFETCH_DISTANCE;
+    if constexpr (distance > 0
+        && requires { Traits::prefetch(graph, std::declval<NodeRef>()); }) {
+      if (pending.size() >= distance) {
+        Traits::prefetch(graph, pending[pending.size() - distance].target);
+      }
+    }
+  }
+
+  void
+  pushSuccessors(std::vector<Edge>& pending, NodeRef node, size_t depth) {
+    for (auto i = Traits::successorCount(graph, node); i > 0; --i) {
+      pending.push_back({node, Traits::successor(graph, node, i - 1), depth + 1});
+    }
+  }
+
+  bool
+  claim(NodeRef node) {
+    return visits.claim(node);
+  }
+
+  GraphKind& graph;
+  OnNode& onNode;
+  OnEdge& onEdge;
+  TaskGroup& group;
+  const ParallelOptions options;
+  ConcurrentVisitTracker<GraphKind, Visits> visits;
+  std::atomic<bool> stopped;
+};
+
+}
+
+
+// Traverses a graph like `traverse`, but fans the work for subtrees out over
+// the workers of `pool`. Callbacks are invoked concurrently from several
+// threads and must be safe to call that way. As with `traverse`, every node
+// is reported once and every edge is reported each time it is followed, and
+// callbacks may return a `Control`; STOP ends the whole traversal as soon as
+// every task notices.
+//
+// When nodes are shared, which task reports a shared node depends on timing,
+// so PER_SUBTREE only makes the order deterministic for graphs without
+// sharing. With `EpochVisits`, nodes are claimed by an atomic exchange on
+// their epoch marks instead of through a locked hash set.
+template<class Visits = HashedVisits, Graph GraphKind, class OnNode, class OnEdge>
+void
+traverseParallel(WorkStealingPool& pool, GraphKind& graph,
+                 OnNode onNode, OnEdge onEdge,
+                 ParallelOptions options = {}) {
+  TaskGroup group{pool};
+  detail::ParallelWalk<GraphKind, Visits, OnNode, OnEdge>
+    parallelWalk{graph, onNode, onEdge, group, options};
+  parallelWalk.run();
+  group.wait();
+}
+
+
+}
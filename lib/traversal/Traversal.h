@@ -2,28 +2,799 @@
 
 #pragma once
 
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <iostream>
+#include <iterator>
 #include <optional>
+#include <ranges>
+#include <span>
+#include <type_traits>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "ExprTree.h"
+#include "Prefetch.h"
 
 namespace traversal {
 
 
-// You will want to define enough constructs in this header to make it so that
-// the traverse function works when passed either a std::list or an ExprTree.
-// You *could* add other constructs.
+// Callbacks passed to a traversal may steer it by returning a `Control`:
+//
+//   CONTINUE   proceed as usual
+//   SKIP       when returned for a node, do not follow the node's successors;
+//              when returned for an edge, do not follow the edge, so that its
+//              target is not entered (it may still be reached along another)
+//   STOP       end the traversal immediately
+//
+// Callbacks that return nothing always continue.
+enum Control : uint8_t {
+  CONTINUE,
+  SKIP,
+  STOP
+};
 
 
-// You should feel free to add template arguments if you want to, but the
-// invocations in the test suite should remain valid.
-template<class GraphKind, class OnNode, class OnEdge>
+namespace detail {
+
+// Whether a callback returns a `Control` is decided at compile time, so a
+// callback returning void costs nothing beyond the call itself.
+template<class Callback, class... Args>
+Control
+invokeWithControl(Callback& callback, Args&&... args) {
+  using Result = std::invoke_result_t<Callback&, Args...>;
+  if constexpr (std::is_void_v<Result>) {
+    std::invoke(callback, std::forward<Args>(args)...);
+    return CONTINUE;
+  } else {
+    static_assert(std::is_convertible_v<Result, Control>,
+      "Traversal callbacks must return void or traversal::Control");
+    return std::invoke(callback, std::forward<Args>(args)...);
+  }
+}
+
+}
+
+
+// `GraphTraits` describes to the traversal engine how to walk a kind of graph.
+// Every specialization provides:
+//
+//   NodeRef                         a cheap, copyable handle to a node
+//   mayShare                        whether a node can be reached along more
+//                                   than one path, so that the engine must
+//                                   remember the nodes it has already visited
+//   entry(graph)                    the node where traversal starts, if any
+//   successorCount(graph, node)     the number of outgoing edges of a node
+//   successor(graph, node, i)       the target of the i-th outgoing edge
+//
+// Graphs that may share nodes can additionally support `EpochVisits` by
+// providing:
+//
+//   newEpoch()                      an epoch that no earlier walk has used
+//   epochOf(graph, node)            a reference to the node's epoch mark
+//
+// Graphs whose nodes live at addresses worth prefetching may also provide
+// `prefetch(graph, node)`, which walks use to request upcoming nodes early.
+//
+// Successors are exposed by index rather than as a range so that the engine
+// never has to store a successor range, only a node and a position.
+//
+// Traits are looked up for the graph type exactly as it is passed, including
+// const, because the handle for a mutable container may differ from that of a
+// const one. Any type satisfying `Graph` below can be traversed; nothing is
+// ever copied into an intermediate container first.
+template<class GraphKind>
+struct GraphTraits;
+
+
+// A graph type may also describe itself through members rather than a
+// specialization of `GraphTraits`. This is convenient for node pools and other
+// graphs defined within a project:
+//
+//   struct Pool {
+//     using NodeRef = uint32_t;
+//     static constexpr bool mayShare = true;
+//     std::optional<NodeRef> entry() const;
+//     size_t successorCount(NodeRef node) const;
+//     NodeRef successor(NodeRef node, size_t index) const;
+//   };
+//
+// Epoch marks are supported when the type provides `static uint64_t
+// newEpoch()` and `uint64_t& epochOf(NodeRef node) const` as well.
+template<class GraphKind>
+concept SelfDescribingGraph = requires(
+    const GraphKind& graph,
+    typename std::remove_const_t<GraphKind>::NodeRef node,
+    size_t index) {
+  { std::remove_const_t<GraphKind>::mayShare } -> std::convertible_to<bool>;
+  { graph.entry() }
+    -> std::same_as<std::optional<typename std::remove_const_t<GraphKind>::NodeRef>>;
+  { graph.successorCount(node) } -> std::convertible_to<size_t>;
+  { graph.successor(node, index) }
+    -> std::convertible_to<typename std::remove_const_t<GraphKind>::NodeRef>;
+};
+
+
+template<SelfDescribingGraph GraphKind>
+struct GraphTraits<GraphKind> {
+  using NodeRef = typename std::remove_const_t<GraphKind>::NodeRef;
+
+  static constexpr bool mayShare = std::remove_const_t<GraphKind>::mayShare;
+
+  static std::optional<NodeRef>
+  entry(const GraphKind& graph) {
+    return graph.entry();
+  }
+
+  static size_t
+  successorCount(const GraphKind& graph, NodeRef node) {
+    return graph.successorCount(node);
+  }
+
+  static NodeRef
+  successor(const GraphKind& graph, NodeRef node, size_t index) {
+    return graph.successor(node, index);
+  }
+
+  static uint64_t
+  newEpoch()
+    requires requires { std::remove_const_t<GraphKind>::newEpoch(); } {
+    return std::remove_const_t<GraphKind>::newEpoch();
+  }
+
+  static uint64_t&
+  epochOf(const GraphKind& graph, NodeRef node)
+    requires requires { graph.epochOf(node); } {
+    return graph.epochOf(node);
+  }
+
+  static void
+  prefetch(const GraphKind& graph, NodeRef node)
+    requires requires { graph.prefetch(node); } {
+    graph.prefetch(node);
+  }
+};
+
+
+// A sequence is treated as a chain in which every element is succeeded by the
+// element after it. This covers std::list, std::forward_list, std::vector,
+// std::deque, and any other forward range.
+template<class Sequence>
+struct ChainTraits {
+  using NodeRef = std::ranges::iterator_t<Sequence>;
+
+  static constexpr bool mayShare = false;
+
+  static std::optional<NodeRef>
+  entry(Sequence& sequence) {
+    if (std::ranges::empty(sequence)) {
+      return {};
+    }
+    return {std::ranges::begin(sequence)};
+  }
+
+  static size_t
+  successorCount(Sequence& sequence, NodeRef node) {
+    return std::next(node) != std::ranges::end(sequence) ? 1 : 0;
+  }
+
+  static NodeRef
+  successor(Sequence& /*sequence*/, NodeRef node, size_t /*index*/) {
+    return std::next(node);
+  }
+};
+
+
+template<class Sequence>
+  requires std::ranges::forward_range<Sequence>
+        && (!SelfDescribingGraph<Sequence>)
+struct GraphTraits<Sequence>
+  : ChainTraits<Sequence>
+    { };
+
+
+// A `CsrGraph` views a graph stored in compressed sparse row form. The
+// successors of node `n` are `targets[offsets[n]]` through
+// `targets[offsets[n + 1] - 1]`, so `offsets` holds one more element than
+// there are nodes. Nodes are named by their indices.
+//
+// To traverse with `EpochVisits`, `epochs` must provide one mark per node.
+// The marks live alongside the graph rather than in it, so that the adjacency
+// arrays themselves may be shared and read only.
+template<class Index = uint32_t>
+struct CsrGraph {
+  using NodeRef = Index;
+
+  static constexpr bool mayShare = true;
+
+  std::span<const Index> offsets;
+  std::span<const Index> targets;
+  Index root = 0;
+  std::span<uint64_t> epochs = {};
+
+  [[nodiscard]] std::optional<NodeRef>
+  entry() const {
+    if (offsets.size() <= size_t{root} + 1) {
+      return {};
+    }
+    return {root};
+  }
+
+  [[nodiscard]] size_t
+  successorCount(NodeRef node) const {
+    return offsets[node + 1] - offsets[node];
+  }
+
+  [[nodiscard]] NodeRef
+  successor(NodeRef node, size_t index) const {
+    return targets[offsets[node] + index];
+  }
+
+  static uint64_t
+  newEpoch() {
+    return exprtree::newEpoch();
+  }
+
+  [[nodiscard]] uint64_t&
+  epochOf(NodeRef node) const {
+    return epochs[node];
+  }
+
+  void
+  prefetch(NodeRef node) const {
+    exprtree::prefetch(&offsets[node]);
+  }
+};
+
+
+namespace detail {
+
+// Without RTTI, finding the operands of an expression relies on the kind
+// that the expression records.
+inline const exprtree::Operation*
+asOperation(const exprtree::Expression& expression) {
+  return expression.kind == exprtree::OPERATION
+    ? static_cast<const exprtree::Operation*>(&expression)
+    : nullptr;
+}
+
+}
+
+
+// An expression tree may reuse a subexpression in several places, so its
+// nodes may be shared. The successors of an operation are its left and right
+// operands, in that order.
+template<>
+struct GraphTraits<const exprtree::ExprTree> {
+  using NodeRef = const exprtree::Expression*;
+
+  static constexpr bool mayShare = true;
+
+  static std::optional<NodeRef>
+  entry(const exprtree::ExprTree& tree) {
+    if (auto* root = tree.getRoot()) {
+      return {root};
+    }
+    return {};
+  }
+
+  static size_t
+  successorCount(const exprtree::ExprTree& /*tree*/, NodeRef node) {
+    return detail::asOperation(*node) ? 2 : 0;
+  }
+
+  static NodeRef
+  successor(const exprtree::ExprTree& /*tree*/, NodeRef node, size_t index) {
+    auto* operation = detail::asOperation(*node);
+    return index == 0 ? &operation->lhs : &operation->rhs;
+  }
+
+  static uint64_t
+  newEpoch() {
+    return exprtree::newEpoch();
+  }
+
+  static uint64_t&
+  epochOf(const exprtree::ExprTree& /*tree*/, NodeRef node) {
+    return node->epoch;
+  }
+
+  static void
+  prefetch(const exprtree::ExprTree& /*tree*/, NodeRef node) {
+    exprtree::prefetch(node);
+  }
+};
+
+template<>
+struct GraphTraits<exprtree::ExprTree>
+  : GraphTraits<const exprtree::ExprTree>
+    { };
+
+
+// The protocol that every traversal requires of a graph.
+template<class GraphKind>
+concept Graph = requires(
+    GraphKind& graph,
+    typename GraphTraits<GraphKind>::NodeRef node,
+    size_t index) {
+  requires std::copyable<typename GraphTraits<GraphKind>::NodeRef>;
+  { GraphTraits<GraphKind>::mayShare } -> std::convertible_to<bool>;
+  { GraphTraits<GraphKind>::entry(graph) }
+    -> std::same_as<std::optional<typename GraphTraits<GraphKind>::NodeRef>>;
+  { GraphTraits<GraphKind>::successorCount(graph, node) }
+    -> std::convertible_to<size_t>;
+  { GraphTraits<GraphKind>::successor(graph, node, index) }
+    -> std::convertible_to<typename GraphTraits<GraphKind>::NodeRef>;
+};
+
+
+// The additional protocol required to traverse a graph with `EpochVisits`.
+template<class GraphKind>
+concept EpochMarkedGraph = Graph<GraphKind> && requires(
+    GraphKind& graph,
+    typename GraphTraits<GraphKind>::NodeRef node) {
+  { GraphTraits<GraphKind>::newEpoch() } -> std::convertible_to<uint64_t>;
+  { GraphTraits<GraphKind>::epochOf(graph, node) } -> std::same_as<uint64_t&>;
+};
+
+
+// How a walk over a graph that may share nodes recognizes the nodes that it
+// has already entered:
+//
+//   HashedVisits   remembers entered nodes in a hash set owned by the walk
+//   EpochVisits    stamps entered nodes with an epoch unique to the walk, so
+//                  that marking a node is a single store and nothing needs to
+//                  be allocated or reset between walks. Because the marks live
+//                  in the graph, two walks using epochs must not run over the
+//                  same nodes at the same time.
+//
+// Walks over graphs that cannot share nodes never track visits at all.
+struct HashedVisits { };
+struct EpochVisits { };
+
+
+namespace detail {
+
+template<Graph GraphKind, class Visits,
+         bool = GraphTraits<GraphKind>::mayShare>
+class VisitTracker {
+public:
+  using NodeRef = typename GraphTraits<GraphKind>::NodeRef;
+
+  explicit VisitTracker(GraphKind& /*graph*/) { }
+
+  [[nodiscard]] bool isVisited(NodeRef /*node*/) const { return false; }
+  void markVisited(NodeRef /*node*/) { }
+};
+
+
+template<class GraphKind>
+class VisitTracker<GraphKind, HashedVisits, true> {
+public:
+  using NodeRef = typename GraphTraits<GraphKind>::NodeRef;
+
+  explicit VisitTracker(GraphKind& /*graph*/)
+    : visited{}
+      { }
+
+  [[nodiscard]] bool
+  isVisited(NodeRef node) const {
+    return visited.contains(node);
+  }
+
+  void
+  markVisited(NodeRef node) {
+    visited.insert(node);
+  }
+
+private:
+  std::unordered_set<NodeRef> visited;
+};
+
+
+template<class GraphKind>
+class VisitTracker<GraphKind, EpochVisits, true> {
+  static_assert(EpochMarkedGraph<GraphKind>,
+    "EpochVisits requires a graph that provides epoch marks");
+
+public:
+  using Traits = GraphTraits<GraphKind>;
+  using NodeRef = typename Traits::NodeRef;
+
+  explicit VisitTracker(GraphKind& graph)
+    : graph{&graph},
+      epoch{Traits::newEpoch()}
+      { }
+
+  [[nodiscard]] bool
+  isVisited(NodeRef node) const {
+    return Traits::epochOf(*graph, node) == epoch;
+  }
+
+  void
+  markVisited(NodeRef node) {
+    Traits::epochOf(*graph, node) = epoch;
+  }
+
+private:
+  GraphKind* graph;
+  uint64_t epoch;
+};
+
+}
+
+
+// A `Walk` is a lazily evaluated depth first traversal of a graph. Rather than
+// pushing nodes and edges to callbacks, it is an input range that produces one
+// `Step` each time it is advanced, so a client may stop at any point, compose
+// the walk with `std::views`, or interleave several walks.
+//
+// Each step follows one edge from `predecessor` to `node`. The very first step
+// has no predecessor. When `discovered` is set, this is the first time the
+// walk has reached `node`, and the walk will enter the node and continue with
+// its successors once advanced. Otherwise the node has been entered before and
+// its successors are not revisited.
+//
+// A client may prune the walk while it is positioned on a step. Calling
+// `skipChildren()` enters the current node without following its successors,
+// while `skipEdge()` does not enter the current node at all, as though the
+// edge to it had never been followed.
+//
+// Shared nodes are recognized as prescribed by `Visits`. When the graph
+// supports prefetching, the walk prefetches the node `prefetchDistance`
+// entries ahead on its stack each time it advances.
+//
+// The walk keeps an explicit stack of the edges that it has yet to follow
+// instead of recursing. All of the state lives in the walk itself, so its
+// iterators are cheap handles that are only valid while the walk is alive
+// and has not been moved.
+template<Graph GraphKind, class Visits = HashedVisits>
+class Walk : public std::ranges::view_interface<Walk<GraphKind, Visits>> {
+public:
+  using Traits = GraphTraits<GraphKind>;
+  using NodeRef = typename Traits::NodeRef;
+
+  struct Step {
+    std::optional<NodeRef> predecessor;
+    NodeRef node;
+    bool discovered;
+  };
+
+  class Iterator {
+  public:
+    using iterator_concept = std::input_iterator_tag;
+    using value_type = Step;
+    using difference_type = std::ptrdiff_t;
+
+    Iterator() = default;
+
+    explicit Iterator(Walk& walk)
+      : walk{&walk}
+        { }
+
+    const Step& operator*() const { return *walk->current; }
+    const Step* operator->() const { return &*walk->current; }
+
+    Iterator&
+    operator++() {
+      walk->advance();
+      return *this;
+    }
+
+    void operator++(int) { walk->advance(); }
+
+    friend bool
+    operator==(const Iterator& iterator, std::default_sentinel_t) {
+      return iterator.atEnd();
+    }
+
+  private:
+    [[nodiscard]] bool atEnd() const { return !walk->current; }
+
+    Walk* walk = nullptr;
+  };
+
+  explicit Walk(GraphKind& graph)
+    : graph{&graph},
+      pending{},
+      visited{graph},
+      current{},
+      started{false},
+      enterCurrent{true},
+      expandCurrent{true},
+      prefetchDistance{exprtree::DEFAULT_PREFETCH_DISTANCE}
+      { }
+
+  [[nodiscard]] Iterator
+  begin() {
+    if (!started) {
+      started = true;
+      if (auto entry = Traits::entry(*graph)) {
+        pending.push_back({{}, *entry});
+      }
+      advance();
+    }
+    return Iterator{*this};
+  }
+
+  [[nodiscard]] std::default_sentinel_t
+  end() const {
+    return std::default_sentinel;
+  }
+
+  void skipChildren() { expandCurrent = false; }
+  void skipEdge() { enterCurrent = false; }
+
+  void setPrefetchDistance(size_t distance) { prefetchDistance = distance; }
+
+private:
+  struct Edge {
+    std::optional<NodeRef> predecessor;
+    NodeRef target;
+  };
+
+  void
+  advance() {
+    if (current && current->discovered && enterCurrent) {
+      enter(current->node, expandCurrent);
+    }
+    enterCurrent = true;
+    expandCurrent = true;
+
+    if (pending.empty()) {
+      current.reset();
+      return;
+    }
+
+    auto [predecessor, target] = pending.back();
+    pending.pop_back();
+    prefetchAhead();
+    current = Step{predecessor, target, !visited.isVisited(target)};
+  }
+
+  void
+  prefetchAhead() const {
+    if constexpr (requires { Traits::prefetch(*graph, std::declval<NodeRef>()); }) {
+      if (prefetchDistance > 0 && pending.size() >= prefetchDistance) {
+        Traits::prefetch(*graph, pending[pending.size() - prefetchDistance].target);
+      }
+    }
+  }
+
+  // Entering a node is deferred until the walk moves past the step that
+  // discovered it, giving the client the chance to prune it. Successors are
+  // pushed in reverse so that they are followed in order.
+  void
+  enter(NodeRef node, bool expand) {
+    visited.markVisited(node);
+    if (!expand) {
+      return;
+    }
+    for (auto i = Traits::successorCount(*graph, node); i > 0; --i) {
+      pending.push_back({node, Traits::successor(*graph, node, i - 1)});
+    }
+  }
+
+  GraphKind* graph;
+  std::vector<Edge> pending;
+  detail::VisitTracker<GraphKind, Visits> visited;
+  std::optional<Step> current;
+  bool started;
+  bool enterCurrent;
+  bool expandCurrent;
+  size_t prefetchDistance;
+};
+
+
+template<class Visits = HashedVisits, Graph GraphKind>
+[[nodiscard]] Walk<GraphKind, Visits>
+walk(GraphKind& graph) {
+  return Walk<GraphKind, Visits>{graph};
+}
+
+
+// The nodes of a graph in the order that a walk first reaches them.
+template<class Visits = HashedVisits, Graph GraphKind>
+[[nodiscard]] auto
+nodes(GraphKind& graph) {
+  using Step = typename Walk<GraphKind, Visits>::Step;
+  return walk<Visits>(graph)
+    | std::views::filter(&Step::discovered)
+    | std::views::transform(&Step::node);
+}
+
+
+// The edges of a graph as (predecessor, successor) pairs in the order that a
+// walk follows them. An edge into a shared node is produced every time it is
+// followed, even though the node itself is only produced once.
+template<class Visits = HashedVisits, Graph GraphKind>
+[[nodiscard]] auto
+edges(GraphKind& graph) {
+  using Step = typename Walk<GraphKind, Visits>::Step;
+  return walk<Visits>(graph)
+    | std::views::filter([] (const Step& step) {
+        return step.predecessor.has_value();
+      })
+    | std::views::transform([] (const Step& step) {
+        return std::pair{*step.predecessor, step.node};
+      });
+}
+
+
+// Traverses a graph depth first, calling `onNode` the first time a node is
+// reached and `onEdge` every time an edge is followed. The edge into a node is
+// always reported before the node itself. Either callback may return a
+// `Control` to prune or stop the traversal.
+//
+// Shared nodes are recognized using a hash set unless another way is chosen,
+// e.g. `traverse<EpochVisits>(tree, onNode, onEdge)`.
+template<class Visits = HashedVisits, Graph GraphKind, class OnNode, class OnEdge>
 void
 traverse(GraphKind& graph, OnNode onNode, OnEdge onEdge) {
+  auto graphWalk = walk<Visits>(graph);
+  for (const auto& step : graphWalk) {
+    if (step.predecessor) {
+      auto control = detail::invokeWithControl(onEdge, *step.predecessor, step.node);
+      if (control == STOP) {
+        return;
+      } else if (control == SKIP) {
+        graphWalk.skipEdge();
+        continue;
+      }
+    }
+    if (step.discovered) {
+      auto control = detail::invokeWithControl(onNode, step.node);
+      if (control == STOP) {
+        return;
+      } else if (control == SKIP) {
+        graphWalk.skipChildren();
+      }
+    }
+  }
 }
 
 
+// Traverses a graph breadth first, calling `onNode` once for every node in
+// order of its distance from the entry, and calling `onEdge` for the edges out
+// of a node right after the node itself. Callbacks may return a `Control` as
+// they may for `traverse`.
+template<class Visits = HashedVisits, Graph GraphKind, class OnNode, class OnEdge>
+void
+traverseBreadthFirst(GraphKind& graph, OnNode onNode, OnEdge onEdge) {
+  using Traits = GraphTraits<GraphKind>;
+  using NodeRef = typename Traits::NodeRef;
+
+  auto entry = Traits::entry(graph);
+  if (!entry) {
+    return;
+  }
+
+  detail::VisitTracker<GraphKind, Visits> visited{graph};
+  std::vector<NodeRef> frontier{*entry};
+  std::vector<NodeRef> next;
+  visited.markVisited(*entry);
+
+  while (!frontier.empty()) {
+    for (auto node : frontier) {
+      auto control = detail::invokeWithControl(onNode, node);
+      if (control == STOP) {
+        return;
+      } else if (control == SKIP) {
+        continue;
+      }
+
+      for (size_t i = 0, e = Traits::successorCount(graph, node); i < e; ++i) {
+        auto successor = Traits::successor(graph, node, i);
+        control = detail::invokeWithControl(onEdge, node, successor);
+        if (control == STOP) {
+          return;
+        } else if (control == SKIP || visited.isVisited(successor)) {
+          continue;
+        }
+        visited.markVisited(successor);
+        next.push_back(successor);
+      }
+    }
+    frontier.swap(next);
+    next.clear();
+  }
 }
 
+
+// Traverses a graph one level at a time. `onLevel` receives all nodes at the
+// same distance from the entry together as one contiguous span, in the order
+// that a breadth first traversal would visit them, so that a level can be
+// processed as a batch. A node shared by several levels belongs to the first
+// that reaches it. `onLevel` may return STOP to end the traversal.
+template<class Visits = HashedVisits, Graph GraphKind, class OnLevel>
+void
+traverseLevels(GraphKind& graph, OnLevel onLevel) {
+  using Traits = GraphTraits<GraphKind>;
+  using NodeRef = typename Traits::NodeRef;
+
+  auto entry = Traits::entry(graph);
+  if (!entry) {
+    return;
+  }
+
+  detail::VisitTracker<GraphKind, Visits> visited{graph};
+  std::vector<NodeRef> frontier{*entry};
+  std::vector<NodeRef> next;
+  visited.markVisited(*entry);
+
+  while (!frontier.empty()) {
+    auto level = std::span<const NodeRef>{frontier};
+    if (detail::invokeWithControl(onLevel, level) == STOP) {
+      return;
+    }
+
+    for (auto node : frontier) {
+      for (size_t i = 0, e = Traits::successorCount(graph, node); i < e; ++i) {
+        auto successor = Traits::successor(graph, node, i);
+        if (!visited.isVisited(successor)) {
+          visited.markVisited(successor);
+          next.push_back(successor);
+        }
+      }
+    }
+    frontier.swap(next);
+    next.clear();
+  }
+}
+
+
+// Traverses a graph depth first like `traverse`, but rather than reporting
+// every node and edge through its own call, buffers them and hands them to
+// `onBatch` in chunks:
+//
+//   onBatch(std::span<const NodeRef> nodes,
+//           std::span<const std::pair<NodeRef,NodeRef>> edges)
+//
+// A batch is delivered whenever either buffer holds `BatchSize` entries, and
+// once more at the end for whatever remains. Nodes and edges each keep their
+// traversal order, but how they interleave with one another is not preserved.
+// `onBatch` may return STOP to end the traversal after the current batch.
+template<size_t BatchSize = 256, class Visits = HashedVisits,
+         Graph GraphKind, class OnBatch>
+void
+traverseBatched(GraphKind& graph, OnBatch onBatch) {
+  static_assert(BatchSize > 0, "Batches must hold at least one entry");
+
+  using NodeRef = typename GraphTraits<GraphKind>::NodeRef;
+  std::vector<NodeRef> nodeBuffer;
+  std::vector<std::pair<NodeRef,NodeRef>> edgeBuffer;
+  nodeBuffer.reserve(BatchSize);
+  edgeBuffer.reserve(BatchSize);
+
+  auto flush = [&] {
+    auto control = detail::invokeWithControl(onBatch,
+      std::span<const NodeRef>{nodeBuffer},
+      std::span<const std::pair<NodeRef,NodeRef>>{edgeBuffer});
+    nodeBuffer.clear();
+    edgeBuffer.clear();
+    return control;
+  };
+
+  for (const auto& step : walk<Visits>(graph)) {
+    if (step.predecessor) {
+      edgeBuffer.emplace_back(*step.predecessor, step.node);
+    }
+    if (step.discovered) {
+      nodeBuffer.push_back(step.node);
+    }
+    if ((nodeBuffer.size() == BatchSize || edgeBuffer.size() == BatchSize)
+        && flush() == STOP) {
+      return;
+    }
+  }
+
+  if (!nodeBuffer.empty() || !edgeBuffer.empty()) {
+    flush();
+  }
+}
+
+
+}
@@ -0,0 +1,158 @@
+
+#include "WorkStealingPool.h"
+
+#include <chrono>
+
+using traversal::TaskGroup;
+using traversal::WorkStealingPool;
+
+
+namespace {
+
+// The worker that the current thread runs for, if any. Spawning from a worker
+// keeps the task local to that worker.
+thread_local const WorkStealingPool* currentPool = nullptr;
+thread_local size_t currentWorker = 0;
+
+}
+
+
+WorkStealingPool::WorkStealingPool(size_t workerCount)
+  : queues{},
+    workers{},
+    queued{0},
+    nextQueue{0},
+    stopping{false} {
+  workerCount = std::max<size_t>(1, workerCount);
+  queues.reserve(workerCount);
+  for (size_t i = 0; i < workerCount; ++i) {
+    queues.push_back(std::make_unique<Queue>());
+  }
+  workers.reserve(workerCount);
+  for (size_t i = 0; i < workerCount; ++i) {
+    workers.emplace_back([this, i] { work(i); });
+  }
+}
+
+
+WorkStealingPool::~WorkStealingPool() {
+  {
+    std::lock_guard lock{sleepMutex};
+    stopping = true;
+  }
+  wake.notify_all();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+
+void
+WorkStealingPool::spawn(Task task) {
+  size_t index = currentPool == this
+    ? currentWorker
+    : nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+  // The count goes up before the task can be seen, so that a thief taking it
+  // never brings the count below zero.
+  queued.fetch_add(1, std::memory_order_release);
+  {
+    std::lock_guard lock{queues[index]->mutex};
+    queues[index]->tasks.push_back(std::move(task));
+  }
+
+  // Taking the sleep lock orders this spawn against a worker that has just
+  // found nothing to do and is about to sleep, so the wakeup is not lost.
+  { std::lock_guard lock{sleepMutex}; }
+  wake.notify_one();
+}
+
+
+bool
+WorkStealingPool::runOne() {
+  size_t home = currentPool == this
+    ? currentWorker
+    : nextQueue.load(std::memory_order_relaxed) % queues.size();
+  return runFrom(home);
+}
+
+
+bool
+WorkStealingPool::runFrom(size_t home) {
+  Task task;
+  {
+    auto& own = *queues[home];
+    std::lock_guard lock{own.mutex};
+    if (!own.tasks.empty()) {
+      task = std::move(own.tasks.back());
+      own.tasks.pop_back();
+    }
+  }
+
+  for (size_t offset = 1; !task && offset < queues.size(); ++offset) {
+    auto& victim = *queues[(home + offset) % queues.size()];
+    std::lock_guard lock{victim.mutex};
+    if (!victim.tasks.empty()) {
+      task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+    }
+  }
+
+  if (!task) {
+    return false;
+  }
+  queued.fetch_sub(1, std::memory_order_relaxed);
+  task();
+  return true;
+}
+
+
+void
+WorkStealingPool::work(size_t index) {
+  currentPool = this;
+  currentWorker = index;
+  while (true) {
+    if (runFrom(index)) {
+      continue;
+    }
+    std::unique_lock lock{sleepMutex};
+    wake.wait(lock, [this] {
+      return stopping || queued.load(std::memory_order_acquire) > 0;
+    });
+    if (stopping) {
+      return;
+    }
+  }
+}
+
+
+void
+TaskGroup::spawn(std::function<void()> task) {
+  pending.fetch_add(1, std::memory_order_relaxed);
+  pool.spawn([this, task = std::move(task)] {
+    task();
+    // The group may be destroyed as soon as a waiter sees that nothing is
+    // pending, so the count is only released while holding the lock that
+    // the waiter takes before returning.
+    std::lock_guard lock{doneMutex};
+    if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      done.notify_all();
+    }
+  });
+}
+
+
+void
+TaskGroup::wait() {
+  while (pending.load(std::memory_order_acquire) > 0) {
+    if (pool.runOne()) {
+      continue;
+    }
+    // Remaining tasks are running elsewhere. Sleep until they finish, but
+    // wake periodically in case they spawn more work that could be helped.
+    std::unique_lock lock{doneMutex};
+    done.wait_for(lock, std::chrono::milliseconds{1}, [this] {
+      return pending.load(std::memory_order_acquire) == 0;
+    });
+  }
+  std::lock_guard lock{doneMutex};
+}
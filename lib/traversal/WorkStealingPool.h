@@ -0,0 +1,97 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace traversal {
+
+
+// A `WorkStealingPool` runs tasks on a fixed set of worker threads. Every
+// worker owns a queue. A task spawned from within a worker is pushed onto that
+// worker's own queue, and a worker runs its most recently spawned task first,
+// so nested work stays hot in its cache. A worker with nothing left to do
+// steals the oldest task from another worker, which tends to be the largest
+// remaining piece of work.
+//
+// The queues are guarded by individual locks rather than being lock free.
+// Tasks are expected to be coarse enough that queue operations are not the
+// bottleneck.
+class WorkStealingPool {
+public:
+  using Task = std::function<void()>;
+
+  explicit WorkStealingPool(
+      size_t workerCount = std::max(1u, std::thread::hardware_concurrency()));
+
+  ~WorkStealingPool();
+
+  WorkStealingPool(const WorkStealingPool&) = delete;
+  WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+  void spawn(Task task);
+
+  // Runs one queued task on the calling thread, if there is one. This lets
+  // threads that wait on the pool help with the work instead of blocking.
+  bool runOne();
+
+  [[nodiscard]] size_t
+  size() const {
+    return workers.size();
+  }
+
+private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  void work(size_t index);
+  bool runFrom(size_t home);
+
+  std::vector<std::unique_ptr<Queue>> queues;
+  std::vector<std::thread> workers;
+  std::atomic<size_t> queued;
+  std::atomic<size_t> nextQueue;
+  std::mutex sleepMutex;
+  std::condition_variable wake;
+  bool stopping;
+};
+
+
+// A `TaskGroup` tracks a set of tasks spawned into a pool so that a caller
+// can wait for exactly those tasks, even when the pool is shared with other
+// work. Tasks may spawn further tasks into the same group.
+class TaskGroup {
+public:
+  explicit TaskGroup(WorkStealingPool& pool)
+    : pool{pool},
+      pending{0}
+      { }
+
+  ~TaskGroup() { wait(); }
+
+  TaskGroup(const TaskGroup&) = delete;
+  TaskGroup& operator=(const TaskGroup&) = delete;
+
+  void spawn(std::function<void()> task);
+
+  // Waits for every task in the group, running queued tasks in the meantime.
+  void wait();
+
+private:
+  WorkStealingPool& pool;
+  std::atomic<size_t> pending;
+  std::mutex doneMutex;
+  std::condition_variable done;
+};
+
+
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "ExprTree.h"
+
+
+// Builds a full binary tree of `height` levels of `opCode` operations, whose
+// leaves are literals numbered in order from `nextLiteral`, and returns its
+// root.
+inline const exprtree::Expression&
+buildFull(exprtree::ExprTree& tree, size_t height, int64_t& nextLiteral,
+          exprtree::OpCode opCode = exprtree::ADD) {
+  if (height == 0) {
+    return tree.addLiteral(nextLiteral++);
+  }
+  const auto& lhs = buildFull(tree, height - 1, nextLiteral, opCode);
+  const auto& rhs = buildFull(tree, height - 1, nextLiteral, opCode);
+  return tree.addOperation(opCode, lhs, rhs);
+}
+
+
+// Builds a random tree with `leafCount` leaves and makes it the root of
+// `tree`. Each leaf is either a literal between -10 and 10, negative ones
+// included, or one of the symbols x and y. Operations combine randomly chosen
+// subtrees in either order, so every operand order and nesting shows up.
+inline void
+buildRandomTree(exprtree::ExprTree& tree, size_t leafCount, unsigned seed) {
+  std::mt19937_64 random{seed};
+  std::vector<const exprtree::Expression*> subtrees;
+  for (size_t i = 0; i < leafCount; ++i) {
+    if (random() % 2 == 0) {
+      subtrees.push_back(&tree.addLiteral(static_cast<int64_t>(random() % 21) - 10));
+    } else {
+      subtrees.push_back(&tree.addSymbol(random() % 2 == 0 ? "x" : "y"));
+    }
+  }
+  while (subtrees.size() > 1) {
+    auto rhs = subtrees.back();
+    subtrees.pop_back();
+    auto index = random() % subtrees.size();
+    auto opCode = static_cast<exprtree::OpCode>(random() % (exprtree::DIVIDE + 1));
+    auto& lhs = subtrees[index];
+    lhs = random() % 2 == 0 ? &tree.addOperation(opCode, *lhs, *rhs)
+                            : &tree.addOperation(opCode, *rhs, *lhs);
+  }
+  tree.setRoot(*subtrees.front());
+}
@@ -0,0 +1,240 @@
+#include "doctest.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Batch.h"
+#include "Columns.h"
+#include "ExprOps.h"
+#include "Trees.h"
+
+using exprtree::BatchProgram;
+using exprtree::evaluateBatch;
+using exprtree::Environment;
+using exprtree::ExprTree;
+using exprtree::Expression;
+using exprtree::MappedColumns;
+using exprtree::OpCode;
+using exprtree::saveColumns;
+using exprtree::serializeColumns;
+
+
+static const std::vector<std::string> NAMES = {"x", "y"};
+
+
+// Returns `rowCount` rows of x and y, each between -10 and 10, so that some
+// rows divide by zero.
+static std::vector<std::vector<int64_t>>
+makeColumns(size_t rowCount, unsigned seed) {
+  std::mt19937_64 random{seed};
+  std::vector<std::vector<int64_t>> columns(NAMES.size());
+  for (auto& column : columns) {
+    for (size_t row = 0; row < rowCount; ++row) {
+      column.push_back(static_cast<int64_t>(random() % 21) - 10);
+    }
+  }
+  return columns;
+}
+
+
+// Checks every row of the batch results against evaluating the tree for
+// that row alone.
+static void
+checkRows(const ExprTree& tree, const MappedColumns& columns,
+          exprtree::OverflowMode overflow = exprtree::WRAP) {
+  auto results = evaluateBatch(tree, columns, overflow);
+  REQUIRE(results.has_value());
+  REQUIRE(results->values.size() == columns.rowCount());
+  Environment env;
+  for (size_t row = 0; row < columns.rowCount(); ++row) {
+    for (size_t column = 0; column < columns.columnCount(); ++column) {
+      env.set(columns.name(column), columns.values(column)[row]);
+    }
+    auto expected = evaluate(tree, env, exprtree::EvaluationOptions{.overflow = overflow});
+    REQUIRE(results->valid[row] == expected.has_value());
+    if (expected) {
+      REQUIRE(results->values[row] == *expected);
+    }
+  }
+}
+
+
+TEST_CASE("empty") {
+  auto bytes = serializeColumns({}, {});
+
+  auto columns = MappedColumns::view(bytes);
+
+  CHECK(columns.getError() == exprtree::LOADED);
+  CHECK(columns.rowCount() == 0);
+  CHECK(columns.columnCount() == 0);
+  CHECK(!columns.find("x").has_value());
+}
+
+
+TEST_CASE("round trip in memory") {
+  auto values = makeColumns(100, 1);
+  auto bytes = serializeColumns(NAMES, values);
+
+  auto columns = MappedColumns::view(bytes);
+
+  REQUIRE(columns.getError() == exprtree::LOADED);
+  CHECK(columns.rowCount() == 100);
+  CHECK(columns.columnCount() == 2);
+  CHECK(columns.name(1) == "y");
+  auto y = columns.find("y");
+  REQUIRE(y.has_value());
+  CHECK(std::vector(y->begin(), y->end()) == values[1]);
+  CHECK(reinterpret_cast<uintptr_t>(y->data()) % alignof(int64_t) == 0);
+  CHECK(!columns.find("z").has_value());
+}
+
+
+TEST_CASE("files") {
+  auto values = makeColumns(10, 2);
+  auto path = (std::filesystem::temp_directory_path() / "expr-io-columns-test.bin").string();
+  REQUIRE(saveColumns(path, NAMES, values));
+
+  auto columns = MappedColumns::open(path);
+
+  REQUIRE(columns.getError() == exprtree::LOADED);
+  auto x = columns.find("x");
+  REQUIRE(x.has_value());
+  CHECK(std::vector(x->begin(), x->end()) == values[0]);
+  CHECK(MappedColumns::open("no/such/file.bin").getError() == exprtree::CANNOT_OPEN);
+  std::remove(path.c_str());
+}
+
+
+TEST_CASE("damaged input is rejected") {
+  auto bytes = serializeColumns(NAMES, makeColumns(10, 3));
+
+  auto truncated = bytes;
+  truncated.resize(truncated.size() - 1);
+  CHECK(MappedColumns::view(truncated).getError() == exprtree::TRUNCATED);
+  CHECK(MappedColumns::view(std::span{bytes}.first(10)).getError() == exprtree::TRUNCATED);
+
+  auto badMagic = bytes;
+  badMagic[0] = std::byte{'X'};
+  CHECK(MappedColumns::view(badMagic).getError() == exprtree::BAD_MAGIC);
+
+  auto badVersion = bytes;
+  badVersion[8] = std::byte{99};
+  CHECK(MappedColumns::view(badVersion).getError() == exprtree::UNSUPPORTED_VERSION);
+
+  auto corrupted = bytes;
+  corrupted[sizeof(exprtree::ColumnsHeader) + 4] ^= std::byte{1};
+  CHECK(MappedColumns::view(corrupted).getError() == exprtree::BAD_CHECKSUM);
+
+  // A name outside of the pool is rejected even when the checksum matches.
+  auto malformed = bytes;
+  auto* header = reinterpret_cast<exprtree::ColumnsHeader*>(malformed.data());
+  auto* records = reinterpret_cast<exprtree::ColumnRecord*>(header + 1);
+  records[1].nameOffset = 5;
+  header->checksum = exprtree::checksum(std::span{malformed}.subspan(
+    sizeof(*header), 2 * sizeof(exprtree::ColumnRecord) + header->namePoolSize));
+  CHECK(MappedColumns::view(malformed).getError() == exprtree::MALFORMED);
+}
+
+
+TEST_CASE("batches match evaluating each row") {
+  // Enough rows for a partial block at the end. The trees are small, and so
+  // are the values, so nothing overflows.
+  auto bytes = serializeColumns(NAMES, makeColumns(BatchProgram::BLOCK_SIZE * 2 + 37, 4));
+  auto columns = MappedColumns::view(bytes);
+  REQUIRE(columns.getError() == exprtree::LOADED);
+
+  for (unsigned seed = 0; seed < 50; ++seed) {
+    CAPTURE(seed);
+    ExprTree tree;
+    buildRandomTree(tree, 1 + seed % 12, seed);
+    checkRows(tree, columns);
+  }
+}
+
+
+TEST_CASE("division by zero leaves a row without a value") {
+  auto bytes = serializeColumns(NAMES, std::vector<std::vector<int64_t>>{{6, 6, 6}, {3, 0, -2}});
+  auto columns = MappedColumns::view(bytes);
+  ExprTree tree;
+  tree.setRoot(tree.addOperation(OpCode::DIVIDE, tree.addSymbol("x"), tree.addSymbol("y")));
+
+  auto results = evaluateBatch(tree, columns);
+
+  REQUIRE(results.has_value());
+  CHECK(results->valid == std::vector<uint8_t>{1, 0, 1});
+  CHECK(results->values[0] == 2);
+  CHECK(results->values[2] == -3);
+}
+
+
+TEST_CASE("overflow modes match evaluating each row") {
+  // Values near the limits, so that most sums and products overflow.
+  std::mt19937_64 random{9};
+  std::vector<std::vector<int64_t>> values(NAMES.size());
+  for (auto& column : values) {
+    for (size_t row = 0; row < BatchProgram::BLOCK_SIZE + 100; ++row) {
+      auto value = static_cast<int64_t>(random() >> (random() % 64));
+      column.push_back(row % 3 == 0 ? -value : value);
+    }
+  }
+  auto bytes = serializeColumns(NAMES, values);
+  auto columns = MappedColumns::view(bytes);
+
+  for (auto overflow : {exprtree::WRAP, exprtree::CHECKED, exprtree::SATURATING}) {
+    for (unsigned seed = 0; seed < 20; ++seed) {
+      CAPTURE(overflow);
+      CAPTURE(seed);
+      ExprTree tree;
+      buildRandomTree(tree, 2 + seed % 6, seed);
+      checkRows(tree, columns, overflow);
+    }
+  }
+}
+
+
+TEST_CASE("deep nesting") {
+  auto bytes = serializeColumns(NAMES, makeColumns(100, 5));
+  auto columns = MappedColumns::view(bytes);
+  ExprTree tree;
+  const Expression* expression = &tree.addSymbol("x");
+  // Deeper than evaluate recurses, so that checking the rows goes through
+  // its explicit stack as well.
+  for (size_t i = 0; i < 5000; ++i) {
+    expression = &tree.addOperation(OpCode::SUBTRACT, tree.addLiteral(1), *expression);
+  }
+  tree.setRoot(*expression);
+
+  checkRows(tree, columns);
+}
+
+
+TEST_CASE("ranges of rows") {
+  auto bytes = serializeColumns(NAMES, makeColumns(3000, 6));
+  auto columns = MappedColumns::view(bytes);
+  ExprTree tree;
+  buildRandomTree(tree, 8, 7);
+  auto program = BatchProgram::compile(tree, columns);
+  REQUIRE(program.has_value());
+  auto whole = evaluateBatch(tree, columns);
+
+  std::vector<int64_t> values(1500);
+  std::vector<uint8_t> valid(1500);
+  program->run(1000, values, valid);
+
+  CHECK(std::equal(values.begin(), values.end(), whole->values.begin() + 1000));
+  CHECK(std::equal(valid.begin(), valid.end(), whole->valid.begin() + 1000));
+}
+
+
+TEST_CASE("missing columns") {
+  auto bytes = serializeColumns(NAMES, makeColumns(10, 8));
+  auto columns = MappedColumns::view(bytes);
+  ExprTree tree;
+  tree.setRoot(tree.addOperation(OpCode::ADD, tree.addSymbol("x"), tree.addSymbol("z")));
+
+  CHECK(!BatchProgram::compile(tree, columns).has_value());
+  CHECK(!BatchProgram::compile(ExprTree{}, columns).has_value());
+}
@@ -0,0 +1,184 @@
+#include "doctest.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ExprOps.h"
+#include "ExprStream.h"
+#include "ParallelParse.h"
+#include "WorkStealingPool.h"
+
+using exprtree::Environment;
+using exprtree::ExprStream;
+using exprtree::ExprTree;
+using exprtree::ParallelParseOptions;
+using exprtree::ParseError;
+using exprtree::ParsedChunk;
+using exprtree::parseFile;
+using exprtree::parseLines;
+using traversal::WorkStealingPool;
+
+
+// Lines of varied length, including blank lines and lines that fail to parse.
+static std::string
+makeText(size_t lineCount) {
+  std::string text;
+  for (size_t i = 0; i < lineCount; ++i) {
+    auto n = std::to_string(i);
+    switch (i % 7) {
+      case 0: text += n + " * x + " + n; break;
+      case 1: text += "(" + n + " - y) / (x + 1)"; break;
+      case 2: text += "   "; break;
+      case 3: text += n + " + * 2"; break;
+      case 4: text += "x"; break;
+      case 5: text += "-" + n + " * -" + n + " - " + n + " * " + n; break;
+      case 6: text += "((((y))))"; break;
+    }
+    text += '\n';
+  }
+  return text;
+}
+
+
+// Evaluates the expression of each line of a chunk in turn, and appends the
+// results to `results`.
+static void
+evaluateChunk(ParsedChunk& chunk, std::vector<std::optional<int64_t>>& results) {
+  Environment env;
+  env.set("x", 5);
+  env.set("y", 7);
+  for (auto* root : chunk.roots) {
+    if (!root) {
+      results.emplace_back();
+      continue;
+    }
+    chunk.tree.setRoot(*root);
+    results.push_back(evaluate(chunk.tree, env));
+  }
+}
+
+
+static std::vector<std::optional<int64_t>>
+evaluateAll(std::vector<ParsedChunk>& chunks) {
+  std::vector<std::optional<int64_t>> results;
+  for (auto& chunk : chunks) {
+    evaluateChunk(chunk, results);
+  }
+  return results;
+}
+
+
+static std::vector<ParseError>
+allErrors(const std::vector<ParsedChunk>& chunks) {
+  std::vector<ParseError> errors;
+  for (const auto& chunk : chunks) {
+    errors.insert(errors.end(), chunk.errors.begin(), chunk.errors.end());
+  }
+  return errors;
+}
+
+
+// Parses `text` one line at a time for comparison.
+static std::pair<std::vector<std::optional<int64_t>>, std::vector<size_t>>
+parseSequentially(const std::string& text) {
+  Environment env;
+  env.set("x", 5);
+  env.set("y", 7);
+  std::istringstream in{text};
+  ExprStream stream{in};
+  ExprTree tree;
+  std::vector<std::optional<int64_t>> results;
+  std::vector<size_t> errorOffsets;
+  for (auto status = stream.next(tree); status != exprtree::END_OF_INPUT;
+       status = stream.next(tree)) {
+    results.push_back(status == exprtree::EXPRESSION ? evaluate(tree, env) : std::nullopt);
+    if (status == exprtree::SYNTAX_ERROR) {
+      errorOffsets.push_back(stream.getError().offset);
+    }
+  }
+  return {results, errorOffsets};
+}
+
+
+TEST_CASE("empty") {
+  WorkStealingPool pool{2};
+
+  auto parsed = parseLines("", pool);
+
+  CHECK(parsed.empty());
+}
+
+
+TEST_CASE("trees are in input order") {
+  auto text = makeText(2000);
+  auto [expected, errorOffsets] = parseSequentially(text);
+  WorkStealingPool pool{4};
+
+  for (size_t chunkSize : {1ul, 100ul, 4096ul, ParallelParseOptions{}.chunkSize}) {
+    CAPTURE(chunkSize);
+    auto parsed = parseLines(text, pool, {exprtree::INFIX, chunkSize});
+
+    CHECK(evaluateAll(parsed) == expected);
+    auto errors = allErrors(parsed);
+    REQUIRE(errors.size() == errorOffsets.size());
+    for (size_t i = 0; i < errorOffsets.size(); ++i) {
+      CHECK(errors[i].offset == errorOffsets[i]);
+      CHECK(errors[i].line == 7 * i + 4);
+      CHECK(text[errors[i].offset] == '*');
+    }
+  }
+}
+
+
+TEST_CASE("chunks are consumed in input order") {
+  auto text = makeText(5000);
+  auto expected = parseSequentially(text).first;
+  WorkStealingPool pool{3};
+  std::vector<std::optional<int64_t>> results;
+  size_t chunkCount = 0;
+  std::vector<const ExprTree*> trees;
+
+  parseLines(text, pool, [&] (ParsedChunk& chunk) {
+    evaluateChunk(chunk, results);
+    ++chunkCount;
+    if (std::find(trees.begin(), trees.end(), &chunk.tree) == trees.end()) {
+      trees.push_back(&chunk.tree);
+    }
+  }, {exprtree::INFIX, 100});
+
+  CHECK(results == expected);
+  CHECK(chunkCount > 100);
+  // Only a few chunks per worker are parsed ahead, in trees that are reused.
+  CHECK(trees.size() <= 4 * pool.size());
+}
+
+
+TEST_CASE("files") {
+  auto text = makeText(100) + "x * y";
+  auto path = (std::filesystem::temp_directory_path() / "expr-io-parallel-test.txt").string();
+  std::ofstream{path} << text;
+  WorkStealingPool pool{3};
+
+  auto parsed = parseFile(path, pool, {exprtree::INFIX, 64});
+
+  REQUIRE(parsed.has_value());
+  CHECK(evaluateAll(*parsed) == parseSequentially(text).first);
+  CHECK(evaluateAll(*parsed).back() == 35);
+  CHECK(!parseFile("no/such/file.txt", pool).has_value());
+  CHECK(!parseFile("no/such/file.txt", pool, [] (ParsedChunk&) {}));
+  std::remove(path.c_str());
+}
+
+
+TEST_CASE("prefix") {
+  WorkStealingPool pool{2};
+
+  auto parsed = parseLines("+ x 1\n* y - x 2\n", pool, {exprtree::PREFIX, 1});
+
+  CHECK(evaluateAll(parsed) == std::vector<std::optional<int64_t>>{6, 21});
+}
@@ -0,0 +1,128 @@
+#include "doctest.h"
+
+#include <string>
+
+#include "ExprOps.h"
+#include "Parser.h"
+
+using exprtree::Environment;
+using exprtree::ExprTree;
+using exprtree::OpCode;
+using exprtree::Parser;
+
+
+namespace doctest {
+
+template <typename T>
+struct StringMaker<std::optional<T>> {
+  static String convert(const std::optional<T>& maybe) {
+    if (!maybe) {
+      return "EMPTY";
+    } else {
+      return std::to_string(*maybe).c_str();
+    }
+  }
+};
+
+}
+
+
+static std::optional<int64_t>
+parseAndEvaluate(std::string_view text, exprtree::Notation notation = exprtree::INFIX) {
+  Environment env;
+  env.set("x", 5);
+  env.set("long_name_2", 7);
+  ExprTree tree;
+  if (parse(text, tree, notation)) {
+    return {};
+  }
+  return evaluate(tree, env);
+}
+
+
+TEST_CASE("infix precedence and associativity") {
+  CHECK(parseAndEvaluate("3 * x + 1") == 16);
+  CHECK(parseAndEvaluate("1 + 3 * x") == 16);
+  CHECK(parseAndEvaluate("(1 + 3) * x") == 20);
+  CHECK(parseAndEvaluate("10 - 4 - 3") == 3);
+  CHECK(parseAndEvaluate("10 - (4 - 3)") == 9);
+  CHECK(parseAndEvaluate("100 / 10 / 5") == 2);
+  CHECK(parseAndEvaluate("x*long_name_2-x/5") == 34);
+  CHECK(parseAndEvaluate("  ((( 42 )))\n") == 42);
+}
+
+
+TEST_CASE("negative literals") {
+  CHECK(parseAndEvaluate("-5") == -5);
+  CHECK(parseAndEvaluate("3 - -5") == 8);
+  CHECK(parseAndEvaluate("3-5") == -2);
+  CHECK(parseAndEvaluate("-9223372036854775808") == INT64_MIN);
+  CHECK(parseAndEvaluate("9223372036854775807") == INT64_MAX);
+}
+
+
+TEST_CASE("prefix") {
+  CHECK(parseAndEvaluate("+ * 3 x 1", exprtree::PREFIX) == 16);
+  CHECK(parseAndEvaluate("* 3 + x 1", exprtree::PREFIX) == 18);
+  CHECK(parseAndEvaluate("- -5 x", exprtree::PREFIX) == -10);
+  CHECK(parseAndEvaluate("42", exprtree::PREFIX) == 42);
+}
+
+
+TEST_CASE("long tokens") {
+  std::string name(100, 'a');
+  std::string text = "12345678901234567 + " + name + " + 1";
+  Environment env;
+  env.set(name, 3);
+  ExprTree tree;
+
+  REQUIRE(!parse(text, tree));
+
+  CHECK(evaluate(tree, env) == 12345678901234571);
+  CHECK(countSymbols(tree).at(name) == 1);
+  CHECK(countOps(tree).at(OpCode::ADD) == 2);
+}
+
+
+TEST_CASE("error positions") {
+  struct Case {
+    std::string_view text;
+    exprtree::Notation notation;
+    size_t offset;
+    size_t line;
+    size_t column;
+  };
+  for (auto [text, notation, offset, line, column] : {
+      Case{"", exprtree::INFIX, 0, 1, 1},
+      Case{"3 +", exprtree::INFIX, 3, 1, 4},
+      Case{"3 + * 4", exprtree::INFIX, 4, 1, 5},
+      Case{"3 4", exprtree::INFIX, 2, 1, 3},
+      Case{"(3 + 4", exprtree::INFIX, 0, 1, 1},
+      Case{"3 + 4)", exprtree::INFIX, 5, 1, 6},
+      Case{"1 +\n 2 $ 3", exprtree::INFIX, 7, 2, 4},
+      Case{"99999999999999999999", exprtree::INFIX, 0, 1, 1},
+      Case{"+ 1", exprtree::PREFIX, 3, 1, 4},
+      Case{"+ 1 2 3", exprtree::PREFIX, 6, 1, 7},
+    }) {
+    CAPTURE(text);
+    ExprTree tree;
+    auto error = parse(text, tree, notation);
+
+    REQUIRE(error.has_value());
+    CHECK(error->offset == offset);
+    CHECK(error->line == line);
+    CHECK(error->column == column);
+    CHECK(tree.getRoot() == nullptr);
+  }
+}
+
+
+TEST_CASE("parsers are reusable") {
+  Parser parser;
+  ExprTree tree;
+
+  CHECK(parser.parse("1 +", tree) == nullptr);
+  CHECK(parser.getError().offset == 3);
+  REQUIRE(parser.parse("2 * (3 + 4)", tree) != nullptr);
+  CHECK(evaluate(tree, Environment{}) == 14);
+}
@@ -0,0 +1,106 @@
+#include "doctest.h"
+
+#include <string>
+#include <vector>
+
+#include "ExprOps.h"
+#include "Parser.h"
+#include "Printer.h"
+#include "Trees.h"
+
+using exprtree::Environment;
+using exprtree::ExprTree;
+using exprtree::Expression;
+using exprtree::OpCode;
+
+
+static std::string
+reprint(std::string_view text, exprtree::Notation notation = exprtree::INFIX) {
+  ExprTree tree;
+  REQUIRE(!parse(text, tree, notation));
+  return toString(tree, notation);
+}
+
+
+TEST_CASE("empty") {
+  ExprTree tree;
+
+  CHECK(toString(tree).empty());
+}
+
+
+TEST_CASE("leaves") {
+  CHECK(reprint("42") == "42");
+  CHECK(reprint("-42") == "-42");
+  CHECK(reprint("-9223372036854775808") == "-9223372036854775808");
+  CHECK(reprint("some_name") == "some_name");
+}
+
+
+TEST_CASE("minimal parentheses") {
+  CHECK(reprint("(3 * x) + 1") == "3 * x + 1");
+  CHECK(reprint("3 * (x + 1)") == "3 * (x + 1)");
+  CHECK(reprint("(1 - 2) - 3") == "1 - 2 - 3");
+  CHECK(reprint("1 - (2 - 3)") == "1 - (2 - 3)");
+  CHECK(reprint("1 + (2 + 3)") == "1 + (2 + 3)");
+  CHECK(reprint("x / (y * 2)") == "x / (y * 2)");
+  CHECK(reprint("(x / y) * 2") == "x / y * 2");
+  CHECK(reprint("((x))") == "x");
+  CHECK(reprint("x - -1") == "x - -1");
+  CHECK(reprint("-1 * (-2 + x)") == "-1 * (-2 + x)");
+}
+
+
+TEST_CASE("prefix") {
+  CHECK(reprint("+ * 3 x 1", exprtree::PREFIX) == "+ * 3 x 1");
+  CHECK(reprint("  -   -5  x", exprtree::PREFIX) == "- -5 x");
+}
+
+
+TEST_CASE("appends to the buffer") {
+  ExprTree tree;
+  REQUIRE(!parse("x + 1", tree));
+  std::string out = "result: ";
+
+  print(tree, out);
+
+  CHECK(out == "result: x + 1");
+}
+
+
+TEST_CASE("round trips") {
+  Environment env;
+  env.set("x", 5);
+  env.set("y", -3);
+  for (unsigned seed = 0; seed < 50; ++seed) {
+    for (auto notation : {exprtree::INFIX, exprtree::PREFIX}) {
+      CAPTURE(seed);
+      ExprTree tree;
+      buildRandomTree(tree, 1 + seed * 3, seed);
+      auto text = toString(tree, notation);
+
+      ExprTree reparsed;
+      REQUIRE(!parse(text, reparsed, notation));
+      CHECK(toString(reparsed, notation) == text);
+      CHECK(evaluate(reparsed, env) == evaluate(tree, env));
+      CHECK(countOps(reparsed) == countOps(tree));
+    }
+  }
+}
+
+
+TEST_CASE("deep nesting") {
+  ExprTree tree;
+  const Expression* expression = &tree.addSymbol("x");
+  for (size_t i = 0; i < 100000; ++i) {
+    expression = &tree.addOperation(OpCode::SUBTRACT, tree.addLiteral(1), *expression);
+  }
+  tree.setRoot(*expression);
+
+  auto text = toString(tree);
+
+  CHECK(text.starts_with("1 - (1 - (1 - "));
+  ExprTree reparsed;
+  REQUIRE(!parse(text, reparsed));
+  CHECK(toString(reparsed) == text);
+}
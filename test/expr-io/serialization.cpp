@@ -0,0 +1,185 @@
+#include "doctest.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "ExprIO.h"
+#include "ExprOps.h"
+#include "Traversal.h"
+
+using exprtree::Environment;
+using exprtree::ExprTree;
+using exprtree::Expression;
+using exprtree::LoadError;
+using exprtree::MappedExprTree;
+using exprtree::NodeRecord;
+using exprtree::OpCode;
+
+
+// (x * 3) + ((x * 3) - y), with x * 3 shared
+static void
+buildShared(ExprTree& tree) {
+  const auto& x = tree.addSymbol("x");
+  const auto& product = tree.addOperation(OpCode::MULTIPLY, x, tree.addLiteral(3));
+  const auto& difference = tree.addOperation(OpCode::SUBTRACT, product, tree.addSymbol("y"));
+  tree.setRoot(tree.addOperation(OpCode::ADD, product, difference));
+}
+
+
+// Returns a file holding `records` and no names, with a matching checksum.
+static std::vector<std::byte>
+makeFile(const std::vector<NodeRecord>& records, uint64_t root) {
+  exprtree::FileHeader header{};
+  header.magic = exprtree::FORMAT_MAGIC;
+  header.version = exprtree::FORMAT_VERSION;
+  header.nodeCount = records.size();
+  header.root = root;
+  std::vector<std::byte> bytes(sizeof(header) + records.size() * sizeof(NodeRecord));
+  std::memcpy(bytes.data() + sizeof(header), records.data(), records.size() * sizeof(NodeRecord));
+  header.checksum = exprtree::checksum(std::span{bytes}.subspan(sizeof(header)));
+  std::memcpy(bytes.data(), &header, sizeof(header));
+  return bytes;
+}
+
+
+TEST_CASE("empty") {
+  ExprTree tree;
+  auto bytes = serialize(tree);
+
+  auto loaded = MappedExprTree::view(bytes);
+
+  CHECK(loaded.getError() == exprtree::LOADED);
+  CHECK(loaded.size() == 0);
+  CHECK(!loaded.entry().has_value());
+  CHECK(!evaluate(loaded, Environment{}).has_value());
+}
+
+
+TEST_CASE("round trip in memory") {
+  Environment env;
+  env.set("x", 4);
+  env.set("y", 5);
+  ExprTree tree;
+  buildShared(tree);
+  auto bytes = serialize(tree);
+
+  auto loaded = MappedExprTree::view(bytes);
+
+  REQUIRE(loaded.getError() == exprtree::LOADED);
+  CHECK(loaded.size() == 6);
+  CHECK(evaluate(loaded, env) == evaluate(tree, env));
+
+  ExprTree rebuilt;
+  loaded.materialize(rebuilt);
+  CHECK(evaluate(rebuilt, env) == 19);
+  CHECK(countOps(rebuilt) == countOps(tree));
+  CHECK(countSymbols(rebuilt) == countSymbols(tree));
+}
+
+
+TEST_CASE("names are pooled") {
+  ExprTree tree;
+  const auto& first = tree.addSymbol("long_symbol_name");
+  const auto& second = tree.addSymbol("long_symbol_name");
+  tree.setRoot(tree.addOperation(OpCode::ADD, first, second));
+
+  auto bytes = serialize(tree);
+  auto loaded = MappedExprTree::view(bytes);
+
+  REQUIRE(loaded.getError() == exprtree::LOADED);
+  CHECK(bytes.size() == sizeof(exprtree::FileHeader) + 3 * sizeof(exprtree::NodeRecord) + 16);
+  CHECK(loaded.name(0) == "long_symbol_name");
+  CHECK(loaded.name(1) == "long_symbol_name");
+}
+
+
+TEST_CASE("traversal in place") {
+  ExprTree tree;
+  buildShared(tree);
+  auto bytes = serialize(tree);
+  auto loaded = MappedExprTree::view(bytes);
+
+  std::vector<exprtree::ExprKind> kinds;
+  size_t edges = 0;
+  traversal::traverse(loaded,
+    [&kinds, &loaded] (auto node) { kinds.push_back(loaded.kind(node)); },
+    [&edges] (auto, auto) { ++edges; });
+
+  CHECK(kinds == std::vector{exprtree::OPERATION, exprtree::OPERATION, exprtree::SYMBOL,
+                             exprtree::LITERAL, exprtree::OPERATION, exprtree::SYMBOL});
+  CHECK(edges == 6);
+}
+
+
+TEST_CASE("files") {
+  Environment env;
+  env.set("x", -2);
+  env.set("y", 1);
+  ExprTree tree;
+  buildShared(tree);
+  auto path = (std::filesystem::temp_directory_path() / "expr-io-files-test.bin").string();
+  REQUIRE(save(tree, path));
+
+  auto loaded = MappedExprTree::open(path);
+
+  REQUIRE(loaded.getError() == exprtree::LOADED);
+  CHECK(evaluate(loaded, env) == -13);
+  CHECK(MappedExprTree::open("no/such/file.bin").getError() == exprtree::CANNOT_OPEN);
+  std::remove(path.c_str());
+}
+
+
+TEST_CASE("damaged input is rejected") {
+  ExprTree tree;
+  buildShared(tree);
+  auto bytes = serialize(tree);
+
+  auto truncated = bytes;
+  truncated.resize(truncated.size() - 1);
+  CHECK(MappedExprTree::view(truncated).getError() == exprtree::TRUNCATED);
+  CHECK(MappedExprTree::view(std::span{bytes}.first(10)).getError() == exprtree::TRUNCATED);
+
+  auto badMagic = bytes;
+  badMagic[0] = std::byte{'X'};
+  CHECK(MappedExprTree::view(badMagic).getError() == exprtree::BAD_MAGIC);
+
+  auto badVersion = bytes;
+  badVersion[8] = std::byte{99};
+  CHECK(MappedExprTree::view(badVersion).getError() == exprtree::UNSUPPORTED_VERSION);
+
+  auto corrupted = bytes;
+  corrupted[sizeof(exprtree::FileHeader) + 8] ^= std::byte{1};
+  CHECK(MappedExprTree::view(corrupted).getError() == exprtree::BAD_CHECKSUM);
+
+  // An operation whose operand comes after it is rejected even when the
+  // checksum matches.
+  auto malformed = bytes;
+  auto* header = reinterpret_cast<exprtree::FileHeader*>(malformed.data());
+  auto* records = reinterpret_cast<exprtree::NodeRecord*>(header + 1);
+  records[2].narrow = 5;
+  header->checksum = exprtree::checksum(std::span{malformed}.subspan(sizeof(*header)));
+  CHECK(MappedExprTree::view(malformed).getError() == exprtree::MALFORMED);
+}
+
+
+TEST_CASE("records the root does not reach are rejected") {
+  NodeRecord one{exprtree::LITERAL, 0, 0, 0, 1};
+  NodeRecord zero{exprtree::LITERAL, 0, 0, 0, 0};
+  NodeRecord quotient{exprtree::OPERATION, exprtree::DIVIDE, 0, 0, 1};
+
+  auto whole = makeFile({one, zero, quotient}, 2);
+  auto loaded = MappedExprTree::view(whole);
+  REQUIRE(loaded.getError() == exprtree::LOADED);
+  CHECK(evaluate(loaded, Environment{}) == std::nullopt);
+
+  // A root other than the last record leaves the records after it
+  // unreachable.
+  auto earlyRoot = makeFile({one, zero, quotient}, 0);
+  CHECK(MappedExprTree::view(earlyRoot).getError() == exprtree::MALFORMED);
+
+  auto unused = makeFile({one, zero, {exprtree::OPERATION, exprtree::ADD, 0, 1, 1}}, 2);
+  CHECK(MappedExprTree::view(unused).getError() == exprtree::MALFORMED);
+}
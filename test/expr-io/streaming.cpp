@@ -0,0 +1,173 @@
+#include "doctest.h"
+
+#include <ext/stdio_filebuf.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <semaphore>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ExprOps.h"
+#include "ExprStream.h"
+
+using exprtree::Environment;
+using exprtree::ExprStream;
+using exprtree::ExprTree;
+
+
+static const std::string TEXT =
+  "3 * x + 1\n"
+  "\n"
+  "  (x - 1) / 2  \r\n"
+  "a_rather_long_symbol_name * 100000000000\n"
+  "x";
+
+
+static std::vector<std::optional<int64_t>>
+evaluateAll(ExprStream& stream) {
+  Environment env;
+  env.set("x", 5);
+  env.set("a_rather_long_symbol_name", 2);
+  std::vector<std::optional<int64_t>> results;
+  auto status = evaluateEach(stream, env,
+    [&results] (const ExprTree&, std::optional<int64_t> result) {
+      results.push_back(result);
+    });
+  CHECK(status == exprtree::END_OF_INPUT);
+  return results;
+}
+
+
+static const std::vector<std::optional<int64_t>> EXPECTED = {16, 2, 200000000000, 5};
+
+
+TEST_CASE("empty") {
+  std::istringstream in{" \n\n"};
+  ExprStream stream{in};
+  ExprTree tree;
+
+  CHECK(stream.next(tree) == exprtree::END_OF_INPUT);
+}
+
+
+TEST_CASE("istream") {
+  for (size_t chunkSize : {1ul, 3ul, 7ul, ExprStream::DEFAULT_CHUNK_SIZE}) {
+    CAPTURE(chunkSize);
+    std::istringstream in{TEXT};
+    ExprStream stream{in, exprtree::INFIX, chunkSize};
+
+    CHECK(evaluateAll(stream) == EXPECTED);
+  }
+}
+
+
+TEST_CASE("pipe") {
+  int ends[2];
+  REQUIRE(::pipe(ends) == 0);
+  std::thread writer{[&ends] {
+    // Write in pieces that split lines, as a slow producer would.
+    for (size_t i = 0; i < TEXT.size(); i += 5) {
+      auto piece = std::min<size_t>(5, TEXT.size() - i);
+      CHECK(::write(ends[1], TEXT.data() + i, piece) == static_cast<ssize_t>(piece));
+    }
+    ::close(ends[1]);
+  }};
+
+  ExprStream stream{ends[0], exprtree::INFIX, 4};
+  CHECK(evaluateAll(stream) == EXPECTED);
+
+  writer.join();
+  ::close(ends[0]);
+}
+
+
+TEST_CASE("istreams do not wait for more lines than they need") {
+  int ends[2];
+  REQUIRE(::pipe(ends) == 0);
+  const std::vector<std::string> lines = {"1 + 2\n", "3 * 4\n", "5 - 6\n"};
+  std::binary_semaphore received{0};
+  bool stalled = false;
+  std::thread writer{[&] {
+    // Each line is only followed by the next once the reader has it.
+    for (const auto& line : lines) {
+      CHECK(::write(ends[1], line.data(), line.size()) == static_cast<ssize_t>(line.size()));
+      stalled |= !received.try_acquire_for(std::chrono::seconds{5});
+    }
+    ::close(ends[1]);
+  }};
+
+  __gnu_cxx::stdio_filebuf<char> buffer{ends[0], std::ios::in};
+  std::istream in{&buffer};
+  ExprStream stream{in};
+  std::vector<std::optional<int64_t>> results;
+  evaluateEach(stream, Environment{}, [&results, &received] (const ExprTree&, auto result) {
+    results.push_back(result);
+    received.release();
+  });
+
+  writer.join();
+  CHECK(!stalled);
+  CHECK(results == std::vector<std::optional<int64_t>>{3, 12, -1});
+}
+
+
+TEST_CASE("syntax errors") {
+  std::istringstream in{"1 + 2\n\n3 +\n+ 4 5\n6\n"};
+  ExprStream stream{in};
+  ExprTree tree;
+
+  REQUIRE(stream.next(tree) == exprtree::EXPRESSION);
+  CHECK(evaluate(tree, Environment{}) == 3);
+
+  REQUIRE(stream.next(tree) == exprtree::SYNTAX_ERROR);
+  CHECK(stream.getError().offset == 10);
+  CHECK(stream.getError().line == 3);
+  CHECK(stream.getError().column == 4);
+
+  REQUIRE(stream.next(tree) == exprtree::SYNTAX_ERROR);
+  CHECK(stream.getError().offset == 11);
+  CHECK(stream.getError().line == 4);
+  CHECK(stream.getError().column == 1);
+
+  REQUIRE(stream.next(tree) == exprtree::EXPRESSION);
+  CHECK(evaluate(tree, Environment{}) == 6);
+  CHECK(stream.next(tree) == exprtree::END_OF_INPUT);
+}
+
+
+TEST_CASE("prefix") {
+  std::istringstream in{"+ * 3 x 1\n- x 1"};
+  ExprStream stream{in, exprtree::PREFIX};
+
+  Environment env;
+  env.set("x", 5);
+  std::vector<std::optional<int64_t>> results;
+  evaluateEach(stream, env, [&results] (const ExprTree&, std::optional<int64_t> result) {
+    results.push_back(result);
+  });
+  CHECK(results == std::vector<std::optional<int64_t>>{16, 4});
+}
+
+
+TEST_CASE("read errors") {
+  ExprStream stream{-1};
+  ExprTree tree;
+
+  CHECK(stream.next(tree) == exprtree::READ_ERROR);
+}
+
+
+TEST_CASE("storage is reused") {
+  std::istringstream in{"1 + 2\n3 + 4\n"};
+  ExprStream stream{in};
+  ExprTree tree;
+
+  REQUIRE(stream.next(tree) == exprtree::EXPRESSION);
+  const auto* first = tree.getRoot();
+  REQUIRE(stream.next(tree) == exprtree::EXPRESSION);
+  CHECK(tree.getRoot() == first);
+  CHECK(evaluate(tree, Environment{}) == 7);
+}
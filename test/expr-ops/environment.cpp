@@ -0,0 +1,380 @@
+#include "doctest.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "ExprOps.h"
+#include "ExprTree.h"
+#include "LayeredEnvironment.h"
+#include "VersionedEnvironment.h"
+
+using exprtree::Environment;
+using exprtree::ExprTree;
+using exprtree::LayeredEnvironment;
+using exprtree::OpCode;
+using exprtree::VersionedEnvironment;
+using exprtree::hashName;
+
+
+namespace doctest {
+
+template <typename T>
+struct StringMaker<std::optional<T>> {
+  static String convert(const std::optional<T>& maybe) {
+    if (!maybe) {
+      return "EMPTY";
+    } else {
+      return std::to_string(*maybe).c_str();
+    }
+  }
+};
+
+}
+
+
+// Appends rather than concatenating, which some compilers warn about spuriously.
+static std::string
+numbered(std::string prefix, int64_t number) {
+  prefix += std::to_string(number);
+  return prefix;
+}
+
+
+TEST_CASE("empty") {
+  Environment env;
+
+  CHECK(env.size() == 0);
+  CHECK(env.get("x") == std::nullopt);
+  CHECK(env.get("") == std::nullopt);
+}
+
+
+TEST_CASE("set and get") {
+  Environment env;
+  env.set("x", 1);
+  env.set("y", -2);
+  env.set("", 3);
+
+  CHECK(env.size() == 3);
+  CHECK(env.get("x") == 1);
+  CHECK(env.get("y") == -2);
+  CHECK(env.get("") == 3);
+  CHECK(env.get("z") == std::nullopt);
+
+  env.set("x", INT64_MIN);
+
+  CHECK(env.size() == 3);
+  CHECK(env.get("x") == INT64_MIN);
+}
+
+
+TEST_CASE("heterogeneous lookup") {
+  Environment env;
+  env.set(std::string{"rate"}, 7);
+  std::string_view text = "rate * x";
+
+  CHECK(env.get(text.substr(0, 4)) == 7);
+  CHECK(env.get(std::string{"rate"}) == 7);
+  CHECK(env.get("rate", hashName("rate")) == 7);
+  CHECK(env.get("rat", hashName("rat")) == std::nullopt);
+}
+
+
+TEST_CASE("many bindings") {
+  Environment env;
+  for (int64_t i = 0; i < 10000; ++i) {
+    env.set(numbered("v", i), i * i);
+  }
+
+  CHECK(env.size() == 10000);
+  for (int64_t i = 0; i < 10000; ++i) {
+    CHECK(env.get(numbered("v", i)) == i * i);
+  }
+  CHECK(env.get("v10000") == std::nullopt);
+}
+
+
+TEST_CASE("reserve") {
+  Environment env;
+  env.set("x", 1);
+  env.reserve(1000);
+  for (int64_t i = 0; i < 1000; ++i) {
+    env.set(numbered("v", i), i);
+  }
+  env.reserve(10);
+
+  CHECK(env.size() == 1001);
+  CHECK(env.get("x") == 1);
+  CHECK(env.get("v999") == 999);
+}
+
+
+TEST_CASE("set all") {
+  std::vector<std::string> names = {"a", "b", "c"};
+  std::vector<std::string_view> views = {"c", "d"};
+  std::vector<int64_t> values = {1, 2, 3};
+  Environment env;
+  env.set("a", 0);
+
+  env.setAll(names, values);
+  env.setAll(views, std::span{values}.first(2));
+
+  CHECK(env.size() == 4);
+  CHECK(env.get("a") == 1);
+  CHECK(env.get("b") == 2);
+  CHECK(env.get("c") == 1);
+  CHECK(env.get("d") == 2);
+}
+
+
+TEST_CASE("prepared bindings") {
+  std::vector<std::pair<std::string, int64_t>> prepared;
+  for (int64_t i = 0; i < 100; ++i) {
+    prepared.emplace_back(numbered("a_name_long_enough_to_be_allocated_", i), i);
+  }
+  prepared.emplace_back("a_name_long_enough_to_be_allocated_0", -1);
+
+  Environment env{std::move(prepared)};
+
+  CHECK(env.size() == 100);
+  CHECK(env.get("a_name_long_enough_to_be_allocated_0") == -1);
+  CHECK(env.get("a_name_long_enough_to_be_allocated_99") == 99);
+}
+
+
+static std::shared_ptr<const LayeredEnvironment>
+makeBase() {
+  Environment bindings;
+  bindings.set("x", 1);
+  bindings.set("y", 2);
+  bindings.set("z", 3);
+  return std::make_shared<const LayeredEnvironment>(std::move(bindings));
+}
+
+
+TEST_CASE("layers override their parents") {
+  auto base = makeBase();
+  LayeredEnvironment variant{base};
+  variant.set("y", 20);
+  variant.set("w", 40);
+
+  CHECK(variant.size() == 2);
+  CHECK(variant.get("x") == 1);
+  CHECK(variant.get("y") == 20);
+  CHECK(variant.get("w") == 40);
+  CHECK(variant.get("v") == std::nullopt);
+  CHECK(base->get("y") == 2);
+  CHECK(base->get("w") == std::nullopt);
+}
+
+
+TEST_CASE("copies of layers are independent") {
+  LayeredEnvironment first{makeBase()};
+  first.set("x", 10);
+
+  auto second = first;
+  second.set("x", 100);
+
+  CHECK(first.get("x") == 10);
+  CHECK(second.get("x") == 100);
+  CHECK(first.getParent() == second.getParent());
+}
+
+
+TEST_CASE("deep chains") {
+  auto layer = makeBase();
+  for (int64_t depth = 0; depth < 100; ++depth) {
+    auto child = std::make_shared<LayeredEnvironment>(layer);
+    child->set(numbered("d", depth), depth);
+    if (depth == 50) {
+      child->set("x", -1);
+    }
+    layer = std::move(child);
+  }
+  LayeredEnvironment leaf{layer};
+
+  for (int repeat = 0; repeat < 2; ++repeat) {
+    CHECK(leaf.get("x") == -1);
+    CHECK(leaf.get("y") == 2);
+    CHECK(leaf.get("d0") == 0);
+    CHECK(leaf.get("d99") == 99);
+    CHECK(leaf.get("missing") == std::nullopt);
+  }
+  leaf.set("y", 5);
+  CHECK(leaf.get("y") == 5);
+
+  auto flat = leaf.flatten();
+  CHECK(flat.size() == 103);
+  CHECK(flat.get("x") == -1);
+  CHECK(flat.get("y") == 5);
+  CHECK(flat.get("z") == 3);
+  CHECK(flat.get("d42") == 42);
+  CHECK(flat.get("missing") == std::nullopt);
+}
+
+
+TEST_CASE("shared layers are read from many threads") {
+  auto layer = makeBase();
+  for (int64_t depth = 0; depth < 8; ++depth) {
+    auto child = std::make_shared<LayeredEnvironment>(layer);
+    child->set(numbered("d", depth), depth);
+    layer = std::move(child);
+  }
+
+  std::atomic<size_t> mismatches = 0;
+  std::vector<std::thread> readers;
+  for (int reader = 0; reader < 4; ++reader) {
+    readers.emplace_back([&layer, &mismatches, reader] {
+      // Each variant looks names up through the shared chain, whose cache
+      // the readers race to build.
+      LayeredEnvironment variant{layer};
+      variant.set("y", reader);
+      for (int repeat = 0; repeat < 1000; ++repeat) {
+        if (layer->get("x") != 1 || layer->get("d0") != 0 || layer->get("d7") != 7
+            || variant.get("y") != reader || variant.get("d7") != 7) {
+          ++mismatches;
+        }
+      }
+    });
+  }
+  for (auto& reader : readers) {
+    reader.join();
+  }
+
+  CHECK(mismatches.load() == 0);
+}
+
+
+TEST_CASE("evaluation with layers") {
+  ExprTree tree;
+  const auto& product = tree.addOperation(OpCode::MULTIPLY, tree.addSymbol("x"), tree.addSymbol("y"));
+  tree.setRoot(tree.addOperation(OpCode::ADD, product, tree.addSymbol("z")));
+  auto base = makeBase();
+  LayeredEnvironment variant{base};
+  variant.set("x", 10);
+
+  CHECK(evaluate(tree, *base) == 5);
+  CHECK(evaluate(tree, variant) == 23);
+}
+
+
+TEST_CASE("snapshots do not change") {
+  VersionedEnvironment versioned;
+  versioned.set("x", 1);
+  auto first = versioned.snapshot();
+
+  versioned.update([] (Environment& bindings) {
+    bindings.set("x", 2);
+    bindings.set("y", 3);
+  });
+  auto second = versioned.snapshot();
+
+  CHECK(first->number == 1);
+  CHECK(first->get("x") == 1);
+  CHECK(first->get("y") == std::nullopt);
+  CHECK(second->number == 2);
+  CHECK(second->get("x") == 2);
+  CHECK(second->get("y") == 3);
+
+  Environment replacement;
+  replacement.set("z", 4);
+  versioned.publish(std::move(replacement));
+
+  CHECK(versioned.snapshot()->number == 3);
+  CHECK(versioned.snapshot()->get("x") == std::nullopt);
+  CHECK(second->get("x") == 2);
+}
+
+
+TEST_CASE("more snapshots than reader slots") {
+  VersionedEnvironment versioned;
+  std::vector<exprtree::EnvironmentSnapshot> snapshots;
+  for (int64_t i = 0; i < 100; ++i) {
+    versioned.set("x", i);
+    snapshots.push_back(versioned.snapshot());
+  }
+  // Dropping every other snapshot frees slots in the middle of each block.
+  for (size_t i = 0; i < snapshots.size(); i += 2) {
+    snapshots[i] = versioned.snapshot();
+  }
+  versioned.set("x", 100);
+
+  for (size_t i = 0; i < snapshots.size(); ++i) {
+    CAPTURE(i);
+    CHECK(snapshots[i]->get("x") == (i % 2 == 0 ? 99 : static_cast<int64_t>(i)));
+  }
+  CHECK(versioned.snapshot()->get("x") == 100);
+}
+
+
+TEST_CASE("readers see whole updates") {
+  ExprTree tree;
+  tree.setRoot(tree.addOperation(OpCode::ADD, tree.addSymbol("x"), tree.addSymbol("y")));
+  Environment initial;
+  initial.set("x", 0);
+  initial.set("y", 0);
+  VersionedEnvironment versioned{std::move(initial)};
+  constexpr int64_t UPDATES = 2000;
+
+  // Every update keeps x + y at 0, so any reader that saw half of an update
+  // would find a nonzero sum.
+  std::thread writer{[&versioned] {
+    for (int64_t i = 1; i <= UPDATES; ++i) {
+      versioned.update([i] (Environment& bindings) {
+        bindings.set("x", i);
+        bindings.set("y", -i);
+      });
+    }
+  }};
+  std::vector<std::thread> readers;
+  std::atomic<bool> consistent = true;
+  for (int reader = 0; reader < 3; ++reader) {
+    readers.emplace_back([&] {
+      uint64_t lastVersion = 0;
+      while (lastVersion < UPDATES) {
+        auto snapshot = versioned.snapshot();
+        if (evaluate(tree, *snapshot) != 0 || snapshot->number < lastVersion) {
+          consistent = false;
+        }
+        lastVersion = snapshot->number;
+      }
+    });
+  }
+
+  writer.join();
+  for (auto& reader : readers) {
+    reader.join();
+  }
+  CHECK(consistent);
+  CHECK(versioned.snapshot()->get("x") == UPDATES);
+}
+
+
+static constexpr std::optional<int64_t>
+lookUpAtCompileTime(std::string_view name) {
+  Environment env;
+  for (int64_t i = 0; i < 20; ++i) {
+    env.set(std::string(static_cast<size_t>(i + 1), 'a'), i);
+  }
+  return env.get(name);
+}
+
+
+static constexpr std::optional<int64_t>
+lookUpPreparedAtCompileTime(std::string_view name) {
+  Environment env{{{"x", 1}, {"y", 2}}};
+  return env.get(name);
+}
+
+
+TEST_CASE("compile time") {
+  static_assert(lookUpAtCompileTime("aaaa") == 3);
+  static_assert(!lookUpAtCompileTime("b").has_value());
+  static_assert(lookUpPreparedAtCompileTime("y") == 2);
+  static_assert(hashName("") == 14695981039346656037ull);
+}
@@ -1,6 +1,8 @@
 
 #include "doctest.h"
 
+#include <limits>
+
 #include "ExprTree.h"
 #include "ExprOps.h"
 
@@ -245,3 +247,157 @@ TEST_CASE("Literals and symbols") {
   CHECK(result == 818);
 }
 
+
+
+TEST_CASE("Prefetch distances") {
+  Environment env;
+  env.set("a", 8);
+
+  ExprTree tree;
+  auto a = tree.addSymbol("a");
+  auto b = tree.addLiteral(13);
+  auto c = tree.addLiteral(21);
+  auto m1 = tree.addOperation(OpCode::MULTIPLY, b, a);
+  auto m2 = tree.addOperation(OpCode::SUBTRACT, c, m1);
+  auto a1 = tree.addOperation(OpCode::ADD, m1, m2);
+  tree.setRoot(a1);
+
+  for (size_t distance : {0, 1, 2, 3, 8}) {
+    CHECK(evaluate(tree, env, exprtree::EvaluationOptions{distance}) == 21);
+  }
+}
+
+
+TEST_CASE("Deep nesting") {
+  Environment env;
+  env.set("x", 1);
+
+  ExprTree tree;
+  const exprtree::Expression* expression = &tree.addLiteral(0);
+  for (size_t i = 0; i < 100000; ++i) {
+    const auto& x = tree.addSymbol("x");
+    expression = i % 2 == 0
+      ? &tree.addOperation(OpCode::ADD, *expression, x)
+      : &tree.addOperation(OpCode::ADD, x, *expression);
+  }
+  tree.setRoot(*expression);
+
+  auto result = evaluate(tree, env);
+
+  CHECK(result == 100000);
+}
+
+
+TEST_CASE("Moved trees") {
+  Environment env;
+  env.set("x", 4);
+
+  ExprTree tree;
+  tree.setRoot(tree.addOperation(OpCode::MULTIPLY, tree.addSymbol("x"), tree.addLiteral(3)));
+
+  ExprTree moved{std::move(tree)};
+  CHECK(evaluate(moved, env) == 12);
+  CHECK(tree.getRoot() == nullptr);
+  CHECK(evaluate(tree, env) == std::nullopt);
+
+  ExprTree assigned;
+  assigned.setRoot(assigned.addLiteral(1));
+  assigned = std::move(moved);
+  CHECK(evaluate(assigned, env) == 12);
+  CHECK(moved.getRoot() == nullptr);
+}
+
+
+static constexpr std::optional<int64_t>
+evaluateAtCompileTime(int64_t xValue) {
+  Environment env;
+  env.set("y", 2);
+  env.set("x", xValue);
+
+  ExprTree tree;
+  const auto& x = tree.addSymbol("x");
+  const auto& y = tree.addSymbol("y");
+  const auto& sum = tree.addOperation(OpCode::ADD, x, tree.addLiteral(1));
+  tree.setRoot(tree.addOperation(OpCode::DIVIDE, sum, y));
+  return evaluate(tree, env);
+}
+
+
+TEST_CASE("Compile time evaluation") {
+  static_assert(evaluateAtCompileTime(7) == 4);
+  static_assert(evaluateAtCompileTime(-3) == -1);
+
+  CHECK(evaluateAtCompileTime(9) == 5);
+}
+
+
+static std::optional<int64_t>
+evaluateOp(OpCode opCode, int64_t lhs, int64_t rhs, exprtree::OverflowMode overflow) {
+  Environment env;
+  env.set("x", lhs);
+  env.set("y", rhs);
+  ExprTree tree;
+  tree.setRoot(tree.addOperation(opCode, tree.addSymbol("x"), tree.addSymbol("y")));
+  return evaluate(tree, env, exprtree::EvaluationOptions{.overflow = overflow});
+}
+
+
+TEST_CASE("Overflow modes") {
+  constexpr auto MAX = std::numeric_limits<int64_t>::max();
+  constexpr auto MIN = std::numeric_limits<int64_t>::min();
+
+  CHECK(evaluateOp(OpCode::ADD, MAX, 1, exprtree::WRAP) == MIN);
+  CHECK(evaluateOp(OpCode::ADD, MAX, 1, exprtree::CHECKED) == std::nullopt);
+  CHECK(evaluateOp(OpCode::ADD, MAX, 1, exprtree::SATURATING) == MAX);
+  CHECK(evaluateOp(OpCode::ADD, MIN, -1, exprtree::SATURATING) == MIN);
+
+  CHECK(evaluateOp(OpCode::SUBTRACT, MIN, 1, exprtree::WRAP) == MAX);
+  CHECK(evaluateOp(OpCode::SUBTRACT, MIN, 1, exprtree::CHECKED) == std::nullopt);
+  CHECK(evaluateOp(OpCode::SUBTRACT, -1, MAX, exprtree::CHECKED) == MIN);
+  CHECK(evaluateOp(OpCode::SUBTRACT, 0, MIN, exprtree::SATURATING) == MAX);
+
+  CHECK(evaluateOp(OpCode::MULTIPLY, MIN, -1, exprtree::WRAP) == MIN);
+  CHECK(evaluateOp(OpCode::MULTIPLY, MIN, -1, exprtree::CHECKED) == std::nullopt);
+  CHECK(evaluateOp(OpCode::MULTIPLY, MIN, -1, exprtree::SATURATING) == MAX);
+  CHECK(evaluateOp(OpCode::MULTIPLY, MAX, -2, exprtree::SATURATING) == MIN);
+  CHECK(evaluateOp(OpCode::MULTIPLY, MAX, 1, exprtree::CHECKED) == MAX);
+
+  // Division that overflows has no result in every mode.
+  for (auto overflow : {exprtree::WRAP, exprtree::CHECKED, exprtree::SATURATING}) {
+    CHECK(evaluateOp(OpCode::DIVIDE, MIN, -1, overflow) == std::nullopt);
+  }
+}
+
+
+TEST_CASE("Overflow in deep trees") {
+  Environment env;
+  env.set("x", std::numeric_limits<int64_t>::max() / 4);
+
+  // Deep enough to be finished by the stack evaluator.
+  ExprTree tree;
+  const exprtree::Expression* expression = &tree.addLiteral(0);
+  for (size_t i = 0; i < 10000; ++i) {
+    expression = &tree.addOperation(OpCode::ADD, tree.addSymbol("x"), *expression);
+  }
+  tree.setRoot(*expression);
+
+  CHECK(evaluate<exprtree::CHECKED>(tree, env) == std::nullopt);
+  CHECK(evaluate<exprtree::SATURATING>(tree, env) == std::numeric_limits<int64_t>::max());
+  CHECK(evaluate<exprtree::WRAP>(tree, env).has_value());
+}
+
+
+static constexpr std::optional<int64_t>
+squareAtCompileTime(int64_t xValue) {
+  Environment env;
+  env.set("x", xValue);
+  ExprTree tree;
+  tree.setRoot(tree.addOperation(OpCode::MULTIPLY, tree.addSymbol("x"), tree.addSymbol("x")));
+  return evaluate<exprtree::CHECKED>(tree, env);
+}
+
+
+TEST_CASE("Compile time overflow") {
+  static_assert(squareAtCompileTime(3037000499) == 9223372030926249001);
+  static_assert(!squareAtCompileTime(3037000500).has_value());
+}
@@ -0,0 +1,116 @@
+#include "doctest.h"
+
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "ExprTree.h"
+#include "ExprOps.h"
+#include "Relayout.h"
+#include "Trees.h"
+
+using exprtree::Environment;
+using exprtree::Expression;
+using exprtree::ExprTree;
+using exprtree::Layout;
+using exprtree::Operation;
+using exprtree::OpCode;
+using exprtree::relayout;
+
+
+static const std::byte*
+addressOf(const Expression& node) {
+  return reinterpret_cast<const std::byte*>(&node);
+}
+
+
+TEST_CASE("empty") {
+  ExprTree tree;
+
+  auto [root, remapping] = relayout(tree);
+
+  CHECK(root == nullptr);
+  CHECK(tree.getRoot() == nullptr);
+  CHECK(remapping.size() == 0);
+}
+
+
+TEST_CASE("results are preserved") {
+  Environment env;
+  env.set("x", 5);
+  for (auto layout : {Layout::PREORDER, Layout::VAN_EMDE_BOAS}) {
+    ExprTree tree;
+    int64_t nextLiteral = 1;
+    const auto& full = buildFull(tree, 7, nextLiteral, OpCode::SUBTRACT);
+    const auto& x = tree.addSymbol("x");
+    const auto& scaled = tree.addOperation(OpCode::MULTIPLY, full, x);
+    tree.setRoot(tree.addOperation(OpCode::ADD, scaled, scaled));
+    auto expected = evaluate(tree, env);
+    auto expectedOps = countOps(tree);
+    auto expectedSymbols = countSymbols(tree);
+
+    auto [root, remapping] = relayout(tree, layout);
+
+    CHECK(root == tree.getRoot());
+    CHECK(evaluate(tree, env) == expected);
+    CHECK(countOps(tree) == expectedOps);
+    CHECK(countSymbols(tree) == expectedSymbols);
+  }
+}
+
+
+TEST_CASE("preorder places nodes in visit order") {
+  ExprTree tree;
+  int64_t nextLiteral = 0;
+  tree.setRoot(buildFull(tree, 6, nextLiteral, OpCode::SUBTRACT));
+
+  relayout(tree, Layout::PREORDER);
+
+  struct OperationFinder final : exprtree::ExprVisitor {
+    const Operation* found = nullptr;
+    void visitImpl(const Operation& operation) final { found = &operation; }
+  } finder;
+  std::vector<const Expression*> pending{tree.getRoot()};
+  const std::byte* last = nullptr;
+  while (!pending.empty()) {
+    auto* node = pending.back();
+    pending.pop_back();
+    CHECK(std::greater<>{}(addressOf(*node), last));
+    last = addressOf(*node);
+    node->accept(finder);
+    if (auto* operation = std::exchange(finder.found, nullptr)) {
+      pending.push_back(&operation->rhs);
+      pending.push_back(&operation->lhs);
+    }
+  }
+}
+
+
+TEST_CASE("handles are remapped") {
+  Environment env;
+  ExprTree tree;
+  auto& two = tree.addLiteral(2);
+  auto& three = tree.addLiteral(3);
+  auto& sum = tree.addOperation(OpCode::ADD, two, three);
+  auto& unused = tree.addLiteral(7);
+  tree.setRoot(tree.addOperation(OpCode::MULTIPLY, sum, sum));
+
+  auto [root, remapping] = relayout(tree, Layout::VAN_EMDE_BOAS);
+
+  CHECK(remapping.size() == 5);
+  CHECK(remapping.find(sum) != nullptr);
+  CHECK(remapping.find(sum) != &sum);
+
+  auto& movedUnused = remapping(unused);
+  ExprTree sumTree;
+  sumTree.setRoot(remapping(sum));
+  CHECK(evaluate(sumTree, env) == 5);
+
+  tree.setRoot(tree.addOperation(OpCode::SUBTRACT, *root, movedUnused));
+  CHECK(evaluate(tree, env) == 18);
+
+  auto [secondRoot, secondRemapping] = relayout(tree);
+  CHECK(secondRemapping.size() == 6);
+  CHECK(evaluate(tree, env) == 18);
+  CHECK(secondRoot == tree.getRoot());
+}
@@ -0,0 +1,69 @@
+#include "doctest.h"
+
+#include <optional>
+#include <string_view>
+
+#include "ExprOps.h"
+#include "ExprTree.h"
+#include "StaticExpr.h"
+
+using exprtree::Environment;
+using exprtree::ExprTree;
+using exprtree::lit;
+using exprtree::sym;
+
+
+// A lookup that can be used in constant expressions.
+struct Bindings {
+  constexpr std::optional<int64_t>
+  get(std::string_view name) const {
+    if (name == "x") {
+      return 4;
+    } else if (name == "y") {
+      return -2;
+    }
+    return {};
+  }
+};
+
+
+TEST_CASE("constant formulas fold at compile time") {
+  constexpr auto formula = lit<3>() * lit<4>() + lit<1>();
+
+  static_assert(decltype(formula)::IS_CONSTANT);
+  static_assert(evaluate(formula) == 13);
+  static_assert(!evaluate(lit<1>() / lit<0>()).has_value());
+}
+
+
+TEST_CASE("symbols with compile time bindings") {
+  constexpr auto formula = lit<3>() * sym<"x">() + sym<"y">() / lit<2>();
+
+  static_assert(!decltype(formula)::IS_CONSTANT);
+  static_assert(evaluate(formula, Bindings{}) == 11);
+  static_assert(!evaluate(sym<"z">() + lit<1>(), Bindings{}).has_value());
+}
+
+
+TEST_CASE("symbols with a runtime environment") {
+  Environment env;
+  env.set("x", 5);
+  auto formula = (lit<3>() - lit<1>()) * sym<"x">();
+
+  CHECK(evaluate(formula, env) == 10);
+  CHECK(!evaluate(formula * sym<"missing">(), env).has_value());
+}
+
+
+TEST_CASE("materialized trees agree") {
+  Environment env;
+  env.set("x", 7);
+  auto formula = lit<3>() * sym<"x">() + lit<1>();
+
+  ExprTree tree;
+  materialize(formula, tree);
+
+  CHECK(evaluate(tree, env) == evaluate(formula, env));
+  CHECK(countOps(tree).size() == 2);
+  CHECK(countSymbols(tree).at("x") == 1);
+}
@@ -0,0 +1,143 @@
+#include "doctest.h"
+
+#include <algorithm>
+#include <string>
+#include <type_traits>
+
+#include "ExprTree.h"
+
+using exprtree::ExprTree;
+using exprtree::ExprVisitor;
+using exprtree::Expression;
+using exprtree::Literal;
+using exprtree::Operation;
+using exprtree::OpCode;
+using exprtree::overloaded;
+using exprtree::Symbol;
+
+
+static_assert(!std::is_polymorphic_v<Expression>,
+  "Expressions should dispatch by kind rather than through a vtable");
+
+
+static std::string
+describe(const Expression& expression) {
+  return visit(expression, overloaded{
+    [] (const Literal& literal) { return std::to_string(literal.value); },
+    [] (const Symbol& symbol) { return symbol.name; },
+    [] (const Operation& operation) {
+      std::string described{"("};
+      described.append(describe(operation.lhs));
+      described.append(" op ");
+      described.append(describe(operation.rhs));
+      described.append(")");
+      return described;
+    },
+  });
+}
+
+
+TEST_CASE("overloaded handlers") {
+  ExprTree tree;
+  auto& three = tree.addLiteral(3);
+  auto& x = tree.addSymbol("x");
+  auto& product = tree.addOperation(OpCode::MULTIPLY, three, x);
+
+  CHECK(describe(three) == "3");
+  CHECK(describe(x) == "x");
+  CHECK(describe(product) == "(3 op x)");
+}
+
+
+TEST_CASE("generic handler") {
+  ExprTree tree;
+  auto& three = tree.addLiteral(3);
+  auto& x = tree.addSymbol("x");
+  auto& sum = tree.addOperation(OpCode::ADD, three, x);
+
+  auto kindOf = [] (const auto& expression) { return expression.kind; };
+
+  CHECK(visit(three, kindOf) == exprtree::LITERAL);
+  CHECK(visit(x, kindOf) == exprtree::SYMBOL);
+  CHECK(visit(sum, kindOf) == exprtree::OPERATION);
+}
+
+
+TEST_CASE("inheritance visitors still dispatch") {
+  struct KindCounter final : ExprVisitor {
+    size_t literals = 0;
+    size_t symbols = 0;
+    size_t operations = 0;
+
+    void visitImpl(const Literal&) final { ++literals; }
+    void visitImpl(const Symbol&) final { ++symbols; }
+    void visitImpl(const Operation&) final { ++operations; }
+  } counter;
+
+  ExprTree tree;
+  auto& three = tree.addLiteral(3);
+  auto& x = tree.addSymbol("x");
+  auto& sum = tree.addOperation(OpCode::ADD, three, x);
+  tree.setRoot(sum);
+
+  three.accept(counter);
+  x.accept(counter);
+  tree.accept(counter);
+
+  CHECK(counter.literals == 1);
+  CHECK(counter.symbols == 1);
+  CHECK(counter.operations == 1);
+}
+
+
+TEST_CASE("typed results") {
+  struct Depth final : exprtree::TypedExprVisitor<size_t> {
+    size_t visitImpl(const Literal&) final { return 1; }
+    size_t visitImpl(const Symbol&) final { return 1; }
+    size_t
+    visitImpl(const Operation& operation) final {
+      return 1 + std::max(visit(operation.lhs), visit(operation.rhs));
+    }
+  } depth;
+
+  ExprTree tree;
+  auto& three = tree.addLiteral(3);
+  auto& x = tree.addSymbol("x");
+  auto& sum = tree.addOperation(OpCode::ADD, three, x);
+  auto& product = tree.addOperation(OpCode::MULTIPLY, sum, x);
+
+  CHECK(depth.visit(three) == 1);
+  CHECK(depth.visit(sum) == 2);
+  CHECK(depth.visit(product) == 3);
+  CHECK(depth.visit(static_cast<const Expression&>(product)) == 3);
+}
+
+
+TEST_CASE("static visitors") {
+  struct Printer final : exprtree::StaticExprVisitor<Printer> {
+    std::string printed;
+
+    void visitLiteral(const Literal& literal) { printed += std::to_string(literal.value); }
+    void visitSymbol(const Symbol& symbol) { printed += symbol.name; }
+  } printer;
+
+  struct Height final : exprtree::StaticExprVisitor<Height> {
+    size_t visitLiteral(const Literal&) { return 1; }
+    size_t visitSymbol(const Symbol&) { return 1; }
+    size_t
+    visitOperation(const Operation& operation) {
+      return 1 + std::max(visit(operation.lhs), visit(operation.rhs));
+    }
+  } height;
+
+  ExprTree tree;
+  auto& three = tree.addLiteral(3);
+  auto& x = tree.addSymbol("x");
+  auto& sum = tree.addOperation(OpCode::ADD, three, x);
+  tree.setRoot(tree.addOperation(OpCode::MULTIPLY, sum, sum));
+
+  printer.walk(tree);
+
+  CHECK(printer.printed == "3x3x");
+  CHECK(height.visit(*tree.getRoot()) == 3);
+}
@@ -0,0 +1,144 @@
+
+#include "doctest.h"
+
+#include <deque>
+#include <forward_list>
+#include <list>
+#include <vector>
+
+#include "Traversal.h"
+
+using traversal::traverse;
+using traversal::CsrGraph;
+using traversal::EpochVisits;
+using traversal::Graph;
+
+
+namespace {
+
+// A minimal node pool in which nodes are named by their index and every node
+// lists its successors.
+struct NodePool {
+  using NodeRef = uint32_t;
+  static constexpr bool mayShare = true;
+
+  std::vector<std::vector<uint32_t>> successors;
+
+  std::optional<NodeRef>
+  entry() const {
+    if (successors.empty()) {
+      return {};
+    }
+    return {0};
+  }
+
+  size_t
+  successorCount(NodeRef node) const {
+    return successors[node].size();
+  }
+
+  NodeRef
+  successor(NodeRef node, size_t index) const {
+    return successors[node][index];
+  }
+};
+
+
+template <class GraphKind>
+std::pair<std::vector<int>, std::vector<std::pair<int,int>>>
+recordValues(GraphKind& graph) {
+  std::pair<std::vector<int>, std::vector<std::pair<int,int>>> results;
+  traverse(graph,
+    [&results] (auto node) { results.first.push_back(*node); },
+    [&results] (auto from, auto to) { results.second.push_back({*from, *to}); });
+  return results;
+}
+
+
+template <class GraphKind>
+std::pair<std::vector<uint32_t>, std::vector<std::pair<uint32_t,uint32_t>>>
+recordIndices(GraphKind& graph) {
+  std::pair<std::vector<uint32_t>, std::vector<std::pair<uint32_t,uint32_t>>> results;
+  traverse(graph,
+    [&results] (auto node) { results.first.push_back(node); },
+    [&results] (auto from, auto to) { results.second.push_back({from, to}); });
+  return results;
+}
+
+}
+
+
+static_assert(Graph<std::list<int>>);
+static_assert(Graph<const std::list<int>>);
+static_assert(Graph<std::vector<int>>);
+static_assert(Graph<std::forward_list<int>>);
+static_assert(Graph<std::deque<int>>);
+static_assert(Graph<exprtree::ExprTree>);
+static_assert(Graph<const exprtree::ExprTree>);
+static_assert(Graph<CsrGraph<>>);
+static_assert(Graph<NodePool>);
+static_assert(!Graph<int>);
+static_assert(traversal::EpochMarkedGraph<CsrGraph<>>);
+static_assert(!traversal::EpochMarkedGraph<NodePool>);
+
+
+TEST_CASE("sequences") {
+  std::vector<std::pair<int,int>> edges = {{5,3}, {3,7}, {7,1}};
+
+  std::vector<int> vector = {5, 3, 7, 1};
+  std::forward_list<int> forwardList = {5, 3, 7, 1};
+  std::deque<int> deque = {5, 3, 7, 1};
+  const std::list<int> list = {5, 3, 7, 1};
+
+  CHECK(recordValues(vector) == std::pair{vector, edges});
+  CHECK(recordValues(forwardList) == std::pair{vector, edges});
+  CHECK(recordValues(deque) == std::pair{vector, edges});
+  CHECK(recordValues(list) == std::pair{vector, edges});
+}
+
+
+TEST_CASE("empty sequences") {
+  std::vector<int> vector;
+  std::forward_list<int> forwardList;
+
+  CHECK(recordValues(vector).first.empty());
+  CHECK(recordValues(forwardList).first.empty());
+}
+
+
+TEST_CASE("csr") {
+  // 0 -> 1, 2;  1 -> 3;  2 -> 3;  3 -> nothing
+  std::vector<uint32_t> offsets = {0, 2, 3, 4, 4};
+  std::vector<uint32_t> targets = {1, 2, 3, 3};
+  std::vector<uint64_t> epochs(4);
+  CsrGraph<> graph{offsets, targets, 0, epochs};
+
+  auto [nodes, edges] = recordIndices(graph);
+
+  CHECK(nodes == std::vector<uint32_t>{0, 1, 3, 2});
+  CHECK(edges == std::vector<std::pair<uint32_t,uint32_t>>{{0,1}, {1,3}, {0,2}, {2,3}});
+
+  std::vector<uint32_t> epochNodes;
+  traverse<EpochVisits>(graph,
+    [&epochNodes] (auto node) { epochNodes.push_back(node); },
+    [] (auto, auto) { });
+  CHECK(epochNodes == nodes);
+}
+
+
+TEST_CASE("empty csr") {
+  std::vector<uint32_t> offsets = {0};
+  CsrGraph<> graph{offsets, {}};
+
+  CHECK(recordIndices(graph).first.empty());
+}
+
+
+TEST_CASE("node pool") {
+  NodePool pool{{{1, 2}, {2}, {0}}};
+
+  auto [nodes, edges] = recordIndices(pool);
+
+  CHECK(nodes == std::vector<uint32_t>{0, 1, 2});
+  CHECK(edges == std::vector<std::pair<uint32_t,uint32_t>>{{0,1}, {1,2}, {2,0}, {0,2}});
+}
@@ -0,0 +1,81 @@
+
+#include "doctest.h"
+
+#include <span>
+#include <vector>
+
+#include "Traversal.h"
+
+using traversal::traverse;
+using traversal::traverseBatched;
+using traversal::Control;
+
+using exprtree::ExprTree;
+using exprtree::Expression;
+using exprtree::OpCode;
+
+using NodeType = const Expression*;
+using NodeList = std::vector<NodeType>;
+using EdgeList = std::vector<std::pair<NodeType,NodeType>>;
+
+
+static const Expression&
+buildChain(ExprTree& tree, size_t length) {
+  const Expression* chain = &tree.addLiteral(0);
+  for (size_t i = 0; i < length; ++i) {
+    chain = &tree.addOperation(OpCode::ADD, *chain, tree.addSymbol("x"));
+  }
+  return *chain;
+}
+
+
+TEST_CASE("empty") {
+  ExprTree tree;
+
+  size_t batches = 0;
+  traverseBatched(tree, [&batches] (auto, auto) { ++batches; });
+
+  CHECK(batches == 0);
+}
+
+
+TEST_CASE("batches match traverse") {
+  ExprTree tree;
+  tree.setRoot(buildChain(tree, 100));
+
+  NodeList expectedNodes;
+  EdgeList expectedEdges;
+  traverse(tree,
+    [&expectedNodes] (auto* node) { expectedNodes.push_back(node); },
+    [&expectedEdges] (auto* from, auto* to) { expectedEdges.push_back({from, to}); });
+
+  NodeList foundNodes;
+  EdgeList foundEdges;
+  std::vector<size_t> edgeBatchSizes;
+  traverseBatched<16>(tree,
+    [&] (std::span<const NodeType> nodes, std::span<const std::pair<NodeType,NodeType>> edges) {
+      CHECK(nodes.size() <= 16);
+      CHECK(edges.size() <= 16);
+      foundNodes.insert(foundNodes.end(), nodes.begin(), nodes.end());
+      foundEdges.insert(foundEdges.end(), edges.begin(), edges.end());
+      edgeBatchSizes.push_back(edges.size());
+    });
+
+  CHECK(foundNodes == expectedNodes);
+  CHECK(foundEdges == expectedEdges);
+  CHECK(expectedEdges.size() == 200);
+  CHECK(edgeBatchSizes.size() == 13);
+}
+
+
+TEST_CASE("stop after batch") {
+  std::vector<int> numbers(100, 1);
+
+  size_t seen = 0;
+  traverseBatched<10>(numbers, [&seen] (auto nodes, auto) {
+    seen += nodes.size();
+    return seen >= 30 ? Control::STOP : Control::CONTINUE;
+  });
+
+  CHECK(seen == 30);
+}
@@ -0,0 +1,125 @@
+
+#include "doctest.h"
+
+#include <list>
+#include <vector>
+
+#include "Traversal.h"
+
+using traversal::traverse;
+using traversal::Control;
+
+using exprtree::ExprTree;
+using exprtree::Expression;
+using exprtree::OpCode;
+
+using NodeType = const Expression*;
+using NodeList = std::vector<NodeType>;
+using EdgeList = std::vector<std::pair<NodeType,NodeType>>;
+
+
+TEST_CASE("stop at node") {
+  std::list<int> numbers = { 5, 3, 7, 1, 9 };
+
+  std::vector<int> foundNodes;
+  std::vector<std::pair<int,int>> foundEdges;
+  auto onNode = [&foundNodes] (auto node) {
+    foundNodes.push_back(*node);
+    return *node == 7 ? Control::STOP : Control::CONTINUE;
+  };
+  auto onEdge = [&foundEdges] (auto predecessor, auto successor) {
+    foundEdges.push_back({*predecessor, *successor});
+  };
+
+  traverse(numbers, onNode, onEdge);
+
+  CHECK(foundNodes == std::vector<int>{5, 3, 7});
+  CHECK(foundEdges == std::vector<std::pair<int,int>>{{5,3}, {3,7}});
+}
+
+
+TEST_CASE("stop at edge") {
+  std::list<int> numbers = { 5, 3, 7, 1, 9 };
+
+  std::vector<int> foundNodes;
+  auto onNode = [&foundNodes] (auto node) {
+    foundNodes.push_back(*node);
+  };
+  auto onEdge = [] (auto /*predecessor*/, auto successor) {
+    return *successor == 1 ? Control::STOP : Control::CONTINUE;
+  };
+
+  traverse(numbers, onNode, onEdge);
+
+  CHECK(foundNodes == std::vector<int>{5, 3, 7});
+}
+
+
+TEST_CASE("skip children") {
+  ExprTree tree;
+  auto a = tree.addSymbol("a");
+  auto b = tree.addSymbol("b");
+  auto c = tree.addLiteral(21);
+  auto d = tree.addLiteral(34);
+  auto m1 = tree.addOperation(OpCode::MULTIPLY, b, a);
+  auto m2 = tree.addOperation(OpCode::MULTIPLY, c, d);
+  auto a1 = tree.addOperation(OpCode::ADD, m1, m2);
+  tree.setRoot(a1);
+
+  NodeList foundNodes;
+  EdgeList foundEdges;
+  auto onNode = [&foundNodes, &m1] (auto* node) {
+    foundNodes.push_back(node);
+    return node == &m1 ? Control::SKIP : Control::CONTINUE;
+  };
+  auto onEdge = [&foundEdges] (auto* predecessor, auto* successor) {
+    foundEdges.push_back({predecessor, successor});
+  };
+
+  traverse(tree, onNode, onEdge);
+
+  CHECK(foundNodes == NodeList{&a1, &m1, &m2, &c, &d});
+  CHECK(foundEdges == EdgeList{{&a1, &m1}, {&a1, &m2}, {&m2, &c}, {&m2, &d}});
+}
+
+
+TEST_CASE("skip edge leaves target reachable") {
+  ExprTree tree;
+  auto a = tree.addSymbol("a");
+  auto b = tree.addSymbol("b");
+  auto m1 = tree.addOperation(OpCode::MULTIPLY, b, a);
+  auto m2 = tree.addOperation(OpCode::MULTIPLY, m1, a);
+  auto a1 = tree.addOperation(OpCode::ADD, m1, m2);
+  tree.setRoot(a1);
+
+  NodeList foundNodes;
+  auto onNode = [&foundNodes] (auto* node) {
+    foundNodes.push_back(node);
+  };
+  auto onEdge = [&a1, &m1] (auto* predecessor, auto* successor) {
+    return predecessor == &a1 && successor == &m1
+      ? Control::SKIP
+      : Control::CONTINUE;
+  };
+
+  traverse(tree, onNode, onEdge);
+
+  CHECK(foundNodes == NodeList{&a1, &m2, &m1, &b, &a});
+}
+
+
+TEST_CASE("void callbacks visit everything") {
+  ExprTree tree;
+  auto a = tree.addSymbol("a");
+  auto m1 = tree.addOperation(OpCode::MULTIPLY, a, a);
+  tree.setRoot(m1);
+
+  size_t nodeCount = 0;
+  size_t edgeCount = 0;
+  traverse(tree,
+    [&nodeCount] (auto*) { ++nodeCount; },
+    [&edgeCount] (auto*, auto*) { ++edgeCount; });
+
+  CHECK(nodeCount == 2);
+  CHECK(edgeCount == 2);
+}
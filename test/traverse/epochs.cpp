@@ -0,0 +1,117 @@
+
+#include "doctest.h"
+
+#include <mutex>
+#include <vector>
+
+#include "ParallelTraversal.h"
+#include "Traversal.h"
+
+using traversal::traverse;
+using traversal::traverseParallel;
+using traversal::EpochVisits;
+using traversal::HashedVisits;
+using traversal::WorkStealingPool;
+
+using exprtree::ExprTree;
+using exprtree::Expression;
+using exprtree::OpCode;
+
+using NodeType = const Expression*;
+using NodeList = std::vector<NodeType>;
+using EdgeList = std::vector<std::pair<NodeType,NodeType>>;
+
+
+template <class Visits>
+static std::pair<NodeList,EdgeList>
+recordTraversal(ExprTree& tree) {
+  std::pair<NodeList,EdgeList> results;
+  traverse<Visits>(tree,
+    [&results] (auto* node) { results.first.push_back(node); },
+    [&results] (auto* from, auto* to) { results.second.push_back({from, to}); });
+  return results;
+}
+
+
+TEST_CASE("Tree with reuse") {
+  ExprTree tree;
+  auto a = tree.addSymbol("a");
+  auto b = tree.addSymbol("b");
+  auto m1 = tree.addOperation(OpCode::MULTIPLY, b, a);
+  auto a1 = tree.addOperation(OpCode::ADD, m1, m1);
+  tree.setRoot(a1);
+
+  NodeList nodes = {&a1, &m1, &b, &a};
+  EdgeList edges = {{&a1, &m1}, {&m1, &b}, {&m1, &a}, {&a1, &m1}};
+
+  auto [foundNodes, foundEdges] = recordTraversal<EpochVisits>(tree);
+
+  CHECK(nodes == foundNodes);
+  CHECK(edges == foundEdges);
+}
+
+
+TEST_CASE("repeated traversals need no reset") {
+  ExprTree tree;
+  const Expression* shared = &tree.addSymbol("x");
+  for (size_t i = 0; i < 8; ++i) {
+    shared = &tree.addOperation(OpCode::MULTIPLY, *shared, *shared);
+  }
+  tree.setRoot(*shared);
+
+  auto expected = recordTraversal<HashedVisits>(tree);
+
+  for (size_t i = 0; i < 3; ++i) {
+    auto found = recordTraversal<EpochVisits>(tree);
+    CHECK(found.first == expected.first);
+    CHECK(found.second == expected.second);
+  }
+}
+
+
+TEST_CASE("trees sharing nodes") {
+  ExprTree outer;
+  auto x = outer.addSymbol("x");
+  auto inner = outer.addOperation(OpCode::ADD, x, x);
+  auto root = outer.addOperation(OpCode::MULTIPLY, inner, x);
+  outer.setRoot(root);
+
+  ExprTree nested;
+  nested.setRoot(inner);
+
+  auto [innerNodes, innerEdges] = recordTraversal<EpochVisits>(nested);
+  auto [outerNodes, outerEdges] = recordTraversal<EpochVisits>(outer);
+
+  CHECK(innerNodes == NodeList{&inner, &x});
+  CHECK(innerEdges.size() == 2);
+  CHECK(outerNodes == NodeList{&root, &inner, &x});
+  CHECK(outerEdges.size() == 4);
+}
+
+
+TEST_CASE("parallel claims") {
+  WorkStealingPool pool{4};
+  ExprTree tree;
+  const Expression* shared = &tree.addSymbol("x");
+  for (size_t i = 0; i < 12; ++i) {
+    shared = &tree.addOperation(OpCode::MULTIPLY, *shared, *shared);
+  }
+  tree.setRoot(*shared);
+
+  std::mutex mutex;
+  NodeList nodes;
+  size_t edgeCount = 0;
+  traverseParallel<EpochVisits>(pool, tree,
+    [&nodes, &mutex] (auto* node) {
+      std::lock_guard lock{mutex};
+      nodes.push_back(node);
+    },
+    [&edgeCount, &mutex] (auto*, auto*) {
+      std::lock_guard lock{mutex};
+      ++edgeCount;
+    },
+    {traversal::UNORDERED, 12});
+
+  CHECK(nodes.size() == 13);
+  CHECK(edgeCount == 24);
+}
@@ -0,0 +1,179 @@
+
+#include "doctest.h"
+
+#include <list>
+#include <ranges>
+#include <vector>
+
+#include "Traversal.h"
+
+using traversal::edges;
+using traversal::nodes;
+using traversal::walk;
+
+using exprtree::ExprTree;
+using exprtree::Expression;
+using exprtree::Literal;
+using exprtree::Operation;
+using exprtree::OpCode;
+
+using NodeType = const Expression*;
+using NodeList = std::vector<NodeType>;
+using EdgeList = std::vector<std::pair<NodeType,NodeType>>;
+
+
+namespace {
+
+class DivisionByZeroFinder final : public exprtree::ExprVisitor {
+public:
+  bool found = false;
+
+private:
+  class ZeroFinder final : public exprtree::ExprVisitor {
+  public:
+    bool isZero = false;
+
+  private:
+    void visitImpl(const Literal& literal) final { isZero = literal.value == 0; }
+  };
+
+  void
+  visitImpl(const Operation& operation) final {
+    ZeroFinder zero;
+    operation.rhs.accept(zero);
+    found = operation.opCode == OpCode::DIVIDE && zero.isZero;
+  }
+};
+
+bool
+isDivisionByZero(NodeType node) {
+  DivisionByZeroFinder finder;
+  node->accept(finder);
+  return finder.found;
+}
+
+}
+
+
+TEST_CASE("empty") {
+  ExprTree tree;
+
+  auto treeWalk = walk(tree);
+  auto treeNodes = nodes(tree);
+
+  CHECK(treeWalk.begin() == treeWalk.end());
+  CHECK(treeNodes.begin() == treeNodes.end());
+}
+
+
+TEST_CASE("nodes and edges match traverse") {
+  ExprTree tree;
+  auto a = tree.addSymbol("a");
+  auto b = tree.addSymbol("b");
+  auto c = tree.addLiteral(21);
+  auto m1 = tree.addOperation(OpCode::MULTIPLY, b, a);
+  auto m2 = tree.addOperation(OpCode::MULTIPLY, c, m1);
+  auto a1 = tree.addOperation(OpCode::ADD, m1, m2);
+  tree.setRoot(a1);
+
+  NodeList expectedNodes;
+  EdgeList expectedEdges;
+  traversal::traverse(tree,
+    [&expectedNodes] (auto* node) { expectedNodes.push_back(node); },
+    [&expectedEdges] (auto* from, auto* to) { expectedEdges.push_back({from, to}); });
+
+  NodeList foundNodes;
+  for (auto* node : nodes(tree)) {
+    foundNodes.push_back(node);
+  }
+  EdgeList foundEdges;
+  for (auto [from, to] : edges(tree)) {
+    foundEdges.push_back({from, to});
+  }
+
+  CHECK(foundNodes == expectedNodes);
+  CHECK(foundEdges == expectedEdges);
+  CHECK(foundNodes.size() == 6);
+  CHECK(foundEdges.size() == 6);
+}
+
+
+TEST_CASE("stop at first division by zero") {
+  ExprTree tree;
+  auto zero = tree.addLiteral(0);
+  auto x = tree.addSymbol("x");
+  auto y = tree.addSymbol("y");
+  auto bad = tree.addOperation(OpCode::DIVIDE, x, zero);
+  auto left = tree.addOperation(OpCode::ADD, bad, y);
+  auto deep = tree.addOperation(OpCode::MULTIPLY, y, y);
+  auto right = tree.addOperation(OpCode::MULTIPLY, deep, deep);
+  auto root = tree.addOperation(OpCode::ADD, left, right);
+  tree.setRoot(root);
+
+  size_t touched = 0;
+  NodeType found = nullptr;
+  for (auto* node : nodes(tree)) {
+    ++touched;
+    if (isDivisionByZero(node)) {
+      found = node;
+      break;
+    }
+  }
+
+  CHECK(found == &bad);
+  CHECK(touched == 3);
+}
+
+
+TEST_CASE("composes with views") {
+  std::list<int> numbers = { 5, 3, 7, 1, 9 };
+
+  std::vector<int> found;
+  for (auto node : nodes(numbers)
+      | std::views::transform([] (auto node) { return *node; })
+      | std::views::filter([] (int number) { return number > 2; })
+      | std::views::take(2)) {
+    found.push_back(node);
+  }
+
+  CHECK(found == std::vector<int>{5, 3});
+}
+
+
+TEST_CASE("interleaved walks") {
+  std::list<int> evens = { 0, 2, 4 };
+  std::list<int> odds = { 1, 3, 5 };
+
+  auto evenWalk = walk(evens);
+  auto oddWalk = walk(odds);
+  std::vector<int> merged;
+  auto even = evenWalk.begin();
+  auto odd = oddWalk.begin();
+  while (even != evenWalk.end() && odd != oddWalk.end()) {
+    merged.push_back(*even->node);
+    merged.push_back(*odd->node);
+    ++even;
+    ++odd;
+  }
+
+  CHECK(merged == std::vector<int>{0, 1, 2, 3, 4, 5});
+}
+
+
+TEST_CASE("shared nodes are discovered once") {
+  ExprTree tree;
+  auto a = tree.addSymbol("a");
+  auto m1 = tree.addOperation(OpCode::MULTIPLY, a, a);
+  auto a1 = tree.addOperation(OpCode::ADD, m1, m1);
+  tree.setRoot(a1);
+
+  size_t steps = 0;
+  size_t discovered = 0;
+  for (const auto& step : walk(tree)) {
+    ++steps;
+    discovered += step.discovered ? 1 : 0;
+  }
+
+  CHECK(steps == 5);
+  CHECK(discovered == 3);
+}
@@ -0,0 +1,118 @@
+
+#include "doctest.h"
+
+#include <list>
+#include <span>
+#include <vector>
+
+#include "Traversal.h"
+
+using traversal::traverseBreadthFirst;
+using traversal::traverseLevels;
+using traversal::Control;
+using traversal::EpochVisits;
+
+using exprtree::ExprTree;
+using exprtree::Expression;
+using exprtree::OpCode;
+
+using NodeType = const Expression*;
+using NodeList = std::vector<NodeType>;
+using EdgeList = std::vector<std::pair<NodeType,NodeType>>;
+
+
+TEST_CASE("empty") {
+  ExprTree tree;
+
+  size_t calls = 0;
+  traverseBreadthFirst(tree,
+    [&calls] (auto*) { ++calls; },
+    [&calls] (auto*, auto*) { ++calls; });
+  traverseLevels(tree, [&calls] (auto) { ++calls; });
+
+  CHECK(calls == 0);
+}
+
+
+TEST_CASE("breadth first order") {
+  ExprTree tree;
+  auto a = tree.addSymbol("a");
+  auto b = tree.addSymbol("b");
+  auto c = tree.addLiteral(21);
+  auto d = tree.addLiteral(34);
+  auto m1 = tree.addOperation(OpCode::MULTIPLY, b, a);
+  auto m2 = tree.addOperation(OpCode::MULTIPLY, c, d);
+  auto a1 = tree.addOperation(OpCode::ADD, m1, m2);
+  tree.setRoot(a1);
+
+  NodeList foundNodes;
+  EdgeList foundEdges;
+  traverseBreadthFirst(tree,
+    [&foundNodes] (auto* node) { foundNodes.push_back(node); },
+    [&foundEdges] (auto* from, auto* to) { foundEdges.push_back({from, to}); });
+
+  CHECK(foundNodes == NodeList{&a1, &m1, &m2, &b, &a, &c, &d});
+  CHECK(foundEdges == EdgeList{
+    {&a1, &m1}, {&a1, &m2}, {&m1, &b}, {&m1, &a}, {&m2, &c}, {&m2, &d}
+  });
+}
+
+
+TEST_CASE("levels") {
+  ExprTree tree;
+  auto a = tree.addSymbol("a");
+  auto b = tree.addSymbol("b");
+  auto c = tree.addLiteral(21);
+  auto m1 = tree.addOperation(OpCode::MULTIPLY, b, a);
+  auto m2 = tree.addOperation(OpCode::MULTIPLY, c, m1);
+  auto a1 = tree.addOperation(OpCode::ADD, m1, m2);
+  tree.setRoot(a1);
+
+  std::vector<NodeList> levels;
+  traverseLevels<EpochVisits>(tree, [&levels] (std::span<const NodeType> level) {
+    levels.emplace_back(level.begin(), level.end());
+  });
+
+  CHECK(levels.size() == 3);
+  CHECK(levels[0] == NodeList{&a1});
+  CHECK(levels[1] == NodeList{&m1, &m2});
+  CHECK(levels[2] == NodeList{&b, &a, &c});
+}
+
+
+TEST_CASE("stop after level") {
+  std::list<int> numbers = { 5, 3, 7, 1, 9 };
+
+  std::vector<int> found;
+  traverseLevels(numbers, [&found] (auto level) {
+    found.push_back(*level.front());
+    return *level.front() == 7
+      ? Control::STOP
+      : Control::CONTINUE;
+  });
+
+  CHECK(found == std::vector<int>{5, 3, 7});
+}
+
+
+TEST_CASE("skip node") {
+  ExprTree tree;
+  auto a = tree.addSymbol("a");
+  auto b = tree.addSymbol("b");
+  auto c = tree.addLiteral(21);
+  auto d = tree.addLiteral(34);
+  auto m1 = tree.addOperation(OpCode::MULTIPLY, b, a);
+  auto m2 = tree.addOperation(OpCode::MULTIPLY, c, d);
+  auto a1 = tree.addOperation(OpCode::ADD, m1, m2);
+  tree.setRoot(a1);
+
+  NodeList foundNodes;
+  traverseBreadthFirst(tree,
+    [&foundNodes, &m1] (auto* node) {
+      foundNodes.push_back(node);
+      return node == &m1 ? Control::SKIP : Control::CONTINUE;
+    },
+    [] (auto*, auto*) { });
+
+  CHECK(foundNodes == NodeList{&a1, &m1, &m2, &c, &d});
+}
@@ -0,0 +1,198 @@
+
+#include "doctest.h"
+
+#include <algorithm>
+#include <atomic>
+#include <list>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ParallelTraversal.h"
+#include "Trees.h"
+
+using traversal::traverse;
+using traversal::traverseParallel;
+using traversal::Control;
+using traversal::Ordering;
+using traversal::WorkStealingPool;
+
+using exprtree::ExprTree;
+using exprtree::Expression;
+using exprtree::OpCode;
+
+using NodeType = const Expression*;
+using NodeList = std::vector<NodeType>;
+using EdgeList = std::vector<std::pair<NodeType,NodeType>>;
+
+
+static std::pair<NodeList,EdgeList>
+recordSequential(ExprTree& tree) {
+  std::pair<NodeList,EdgeList> results;
+  traverse(tree,
+    [&results] (auto* node) { results.first.push_back(node); },
+    [&results] (auto* from, auto* to) { results.second.push_back({from, to}); });
+  return results;
+}
+
+
+static std::pair<NodeList,EdgeList>
+recordParallel(WorkStealingPool& pool, ExprTree& tree, traversal::ParallelOptions options) {
+  std::mutex mutex;
+  std::pair<NodeList,EdgeList> results;
+  traverseParallel(pool, tree,
+    [&results, &mutex] (auto* node) {
+      std::lock_guard lock{mutex};
+      results.first.push_back(node);
+    },
+    [&results, &mutex] (auto* from, auto* to) {
+      std::lock_guard lock{mutex};
+      results.second.push_back({from, to});
+    },
+    options);
+  return results;
+}
+
+
+TEST_CASE("empty") {
+  WorkStealingPool pool{2};
+  ExprTree tree;
+
+  auto [nodes, edges] = recordParallel(pool, tree, {});
+
+  CHECK(nodes.empty());
+  CHECK(edges.empty());
+}
+
+
+TEST_CASE("unordered visits everything once") {
+  WorkStealingPool pool{4};
+  ExprTree tree;
+  int64_t nextLiteral = 0;
+  tree.setRoot(buildFull(tree, 10, nextLiteral));
+
+  auto [expectedNodes, expectedEdges] = recordSequential(tree);
+  auto [nodes, edges] = recordParallel(pool, tree, {Ordering::UNORDERED, 4});
+
+  std::sort(expectedNodes.begin(), expectedNodes.end());
+  std::sort(nodes.begin(), nodes.end());
+  std::sort(expectedEdges.begin(), expectedEdges.end());
+  std::sort(edges.begin(), edges.end());
+  CHECK(nodes == expectedNodes);
+  CHECK(edges == expectedEdges);
+}
+
+
+TEST_CASE("shared nodes are reported once") {
+  WorkStealingPool pool{4};
+  ExprTree tree;
+  const Expression* shared = &tree.addSymbol("x");
+  for (size_t i = 0; i < 12; ++i) {
+    shared = &tree.addOperation(OpCode::MULTIPLY, *shared, *shared);
+  }
+  tree.setRoot(*shared);
+
+  auto [nodes, edges] = recordParallel(pool, tree, {Ordering::UNORDERED, 12});
+
+  CHECK(nodes.size() == 13);
+  CHECK(edges.size() == 24);
+}
+
+
+TEST_CASE("per subtree order is depth first") {
+  WorkStealingPool pool{4};
+  ExprTree tree;
+  int64_t nextLiteral = 0;
+  const auto& lhs = buildFull(tree, 6, nextLiteral);
+  const auto& rhs = buildFull(tree, 6, nextLiteral);
+  const auto& root = tree.addOperation(OpCode::SUBTRACT, lhs, rhs);
+  tree.setRoot(root);
+
+  ExprTree lhsTree;
+  lhsTree.setRoot(lhs);
+  ExprTree rhsTree;
+  rhsTree.setRoot(rhs);
+  auto [lhsNodes, lhsEdges] = recordSequential(lhsTree);
+  auto [rhsNodes, rhsEdges] = recordSequential(rhsTree);
+
+  auto [nodes, edges] = recordParallel(pool, tree, {Ordering::PER_SUBTREE, 1});
+
+  auto inSubtree = [] (const NodeList& subtree) {
+    return [&subtree] (NodeType node) {
+      return std::find(subtree.begin(), subtree.end(), node) != subtree.end();
+    };
+  };
+  NodeList foundLhs;
+  std::copy_if(nodes.begin(), nodes.end(), std::back_inserter(foundLhs), inSubtree(lhsNodes));
+  NodeList foundRhs;
+  std::copy_if(nodes.begin(), nodes.end(), std::back_inserter(foundRhs), inSubtree(rhsNodes));
+
+  CHECK(nodes.size() == 1 + lhsNodes.size() + rhsNodes.size());
+  CHECK(nodes.front() == &root);
+  CHECK(foundLhs == lhsNodes);
+  CHECK(foundRhs == rhsNodes);
+}
+
+
+TEST_CASE("per subtree tasks report their own roots") {
+  WorkStealingPool pool{4};
+  ExprTree tree;
+  int64_t nextLiteral = 0;
+  tree.setRoot(buildFull(tree, 14, nextLiteral));
+
+  std::mutex mutex;
+  std::map<NodeType, std::thread::id> reporters;
+  traverseParallel(pool, tree,
+    [&reporters, &mutex] (auto* node) {
+      std::lock_guard lock{mutex};
+      reporters[node] = std::this_thread::get_id();
+    },
+    [] (auto*, auto*) { },
+    {Ordering::PER_SUBTREE, 2});
+
+  // Every subtree rooted at depth 2 is reported on one thread, root and all.
+  const auto& root = static_cast<const exprtree::Operation&>(*tree.getRoot());
+  for (const auto* child : {&root.lhs, &root.rhs}) {
+    const auto& operation = static_cast<const exprtree::Operation&>(*child);
+    for (const auto* subtreeRoot : {&operation.lhs, &operation.rhs}) {
+      ExprTree subtree;
+      subtree.setRoot(*subtreeRoot);
+      auto [subtreeNodes, subtreeEdges] = recordSequential(subtree);
+      auto reporter = reporters.at(subtreeRoot);
+      CHECK(std::all_of(subtreeNodes.begin(), subtreeNodes.end(),
+        [&reporters, reporter] (NodeType node) { return reporters.at(node) == reporter; }));
+    }
+  }
+}
+
+
+TEST_CASE("stop ends every task") {
+  WorkStealingPool pool{4};
+  ExprTree tree;
+  int64_t nextLiteral = 0;
+  tree.setRoot(buildFull(tree, 12, nextLiteral));
+
+  std::atomic<size_t> count = 0;
+  traverseParallel(pool, tree,
+    [&count] (auto*) {
+      return ++count >= 10 ? Control::STOP : Control::CONTINUE;
+    },
+    [] (auto*, auto*) { });
+
+  CHECK(count.load() < (size_t{1} << 13) - 1);
+}
+
+
+TEST_CASE("lists") {
+  WorkStealingPool pool{2};
+  std::list<int> numbers = { 5, 3, 7, 1, 9 };
+
+  std::vector<int> found;
+  traverseParallel(pool, numbers,
+    [&found] (auto node) { found.push_back(*node); },
+    [] (auto, auto) { },
+    {Ordering::PER_SUBTREE, 100});
+
+  CHECK(found == std::vector<int>{5, 3, 7, 1, 9});
+}